@@ -0,0 +1,239 @@
+/*
+ * Module: binlog-decode
+ *
+ * Function: host-side decoder of BinaryLog records
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ *
+ * Build (Linux):
+ * 	g++ -std=c++17 -O2 -I../../src -o binlog-decode binlog-decode.cpp
+ *
+ * Generate the format table at build time from the sketch sources:
+ * 	binlog-decode --table sketch.ino sensors.cpp > formats.tbl
+ *
+ * Decode a capture (raw bytes read from the serial port):
+ * 	binlog-decode formats.tbl < capture.bin
+ */
+
+#include <BinaryLog.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Escape / unescape format strings stored in the table (one line per format)
+ */
+static string escape(const string & str) {
+	string res;
+	for (char c: str) {
+		switch (c) {
+			case '\n': res += "\\n"; break;
+			case '\r': res += "\\r"; break;
+			case '\t': res += "\\t"; break;
+			case '\\': res += "\\\\"; break;
+			case '"': res += "\\\""; break;
+			default: res += c;
+		}
+	}
+	return res;
+}
+
+static string unescape(const string & str) {
+	string res;
+	for (size_t i = 0; i < str.size(); i++) {
+		if (str[i] != '\\' || i + 1 == str.size()) {
+			res += str[i];
+			continue;
+		}
+		switch (str[++i]) {
+			case 'n': res += '\n'; break;
+			case 'r': res += '\r'; break;
+			case 't': res += '\t'; break;
+			default: res += str[i];
+		}
+	}
+	return res;
+}
+
+/*
+ * Extracts the format literals of every BINLOG(log, "...", ...) call found in a source file
+ * adjacent literals are concatenated, as the compiler does
+ */
+static void extractFormats(const string & source, map<uint32_t, string> & table) {
+	static const string macro = "BINLOG(";
+	size_t pos = 0;
+	while ((pos = source.find(macro, pos)) != string::npos) {
+		pos += macro.size();
+		size_t comma = source.find(',', pos);
+		if (comma == string::npos)
+			break;
+		string literal;
+		size_t cur = comma + 1;
+		for (;;) {
+			while (cur < source.size() && isspace(static_cast<unsigned char>(source[cur])))
+				cur++;
+			if (cur >= source.size() || source[cur] != '"')
+				break;
+			size_t end = ++cur;
+			while (end < source.size() && source[end] != '"') {
+				end += (source[end] == '\\' ? 2 : 1);
+			}
+			literal += source.substr(cur, end - cur);
+			cur = end + 1;
+		}
+		if (literal.empty())
+			continue;
+		string fmt = unescape(literal);
+		table[binaryLogId(fmt.c_str())] = fmt;
+	}
+}
+
+static int generateTable(int argc, char** argv) {
+	map<uint32_t, string> table;
+	for (int i = 2; i < argc; i++) {
+		ifstream in(argv[i]);
+		if (!in) {
+			cerr << "cannot read " << argv[i] << endl;
+			return 1;
+		}
+		extractFormats(string(istreambuf_iterator<char>(in), istreambuf_iterator<char>()), table);
+	}
+	for (auto & entry: table) {
+		printf("%08x\t%s\n", entry.first, escape(entry.second).c_str());
+	}
+	return 0;
+}
+
+static bool loadTable(const char* file, map<uint32_t, string> & table) {
+	ifstream in(file);
+	if (!in)
+		return false;
+	string line;
+	while (getline(in, line)) {
+		size_t tab = line.find('\t');
+		if (tab == string::npos)
+			continue;
+		table[stoul(line.substr(0, tab), nullptr, 16)] = unescape(line.substr(tab + 1));
+	}
+	return true;
+}
+
+static uint64_t readLE(const uint8_t* data, int size) {
+	uint64_t value = 0;
+	for (int i = size - 1; i >= 0; i--) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+
+/*
+ * Rebuilds the text of a record, each conversion being formatted by snprintf
+ * with a length modifier adapted to the host types
+ */
+static string format(const string & fmt, const uint8_t* payload) {
+	string res;
+	char buf[128];
+	const char* cur = fmt.c_str();
+	while (*cur != 0) {
+		if (*cur != '%') {
+			res += *cur++;
+			continue;
+		}
+		if (cur[1] == '%') {
+			res += '%';
+			cur += 2;
+			continue;
+		}
+		const char* start = cur++;
+		int size = binaryLogArgSize(cur);
+		char conv = cur[-1];
+		string spec(start, cur - 1);
+		while (!spec.empty() && strchr("hlLjzt", spec.back()) != nullptr) {
+			spec.pop_back();
+		}
+		uint64_t raw = readLE(payload, size);
+		payload += size;
+		switch (conv) {
+			case 'd': case 'i': {
+				int64_t value = static_cast<int64_t>(raw << (64 - 8 * size)) >> (64 - 8 * size);
+				snprintf(buf, sizeof buf, (spec + "ll" + conv).c_str(), static_cast<long long>(value));
+				break;
+			}
+			case 'c':
+				snprintf(buf, sizeof buf, (spec + conv).c_str(), static_cast<int>(raw));
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+				double value;
+				if (size == 4) {
+					float f;
+					uint32_t bits = static_cast<uint32_t>(raw);
+					memcpy(&f, &bits, sizeof f);
+					value = f;
+				} else {
+					memcpy(&value, &raw, sizeof value);
+				}
+				snprintf(buf, sizeof buf, (spec + conv).c_str(), value);
+				break;
+			}
+			default:
+				snprintf(buf, sizeof buf, (spec + "ll" + conv).c_str(), static_cast<unsigned long long>(raw));
+		}
+		res += buf;
+	}
+	return res;
+}
+
+static int decode(const char* tableFile) {
+	map<uint32_t, string> table;
+	if (!loadTable(tableFile, table)) {
+		cerr << "cannot read " << tableFile << endl;
+		return 1;
+	}
+	vector<uint8_t> data((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+	size_t pos = 0;
+	uint32_t skipped = 0;
+	while (pos + BinaryLog<ostream>::HEADER_SIZE <= data.size()) {
+		uint32_t id = readLE(&data[pos], 4);
+		uint8_t len = data[pos + 4];
+		auto entry = table.find(id);
+		if (entry == table.end()
+			|| binaryLogPayloadSize(entry->second.c_str()) != len
+			|| pos + BinaryLog<ostream>::HEADER_SIZE + len > data.size()) {
+			// unknown record or lost bytes: resynchronize on next byte
+			pos++;
+			skipped++;
+			continue;
+		}
+		cout << format(entry->second, &data[pos + BinaryLog<ostream>::HEADER_SIZE]);
+		if (entry->second.empty() || entry->second.back() != '\n')
+			cout << '\n';
+		pos += BinaryLog<ostream>::HEADER_SIZE + len;
+	}
+	if (skipped > 0 || pos != data.size()) {
+		cerr << skipped << " bytes skipped, " << (data.size() - pos) << " trailing bytes" << endl;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc >= 3 && strcmp(argv[1], "--table") == 0) {
+		return generateTable(argc, argv);
+	}
+	if (argc == 2) {
+		return decode(argv[1]);
+	}
+	cerr << "usage: " << argv[0] << " --table SOURCE... > TABLE" << endl;
+	cerr << "       " << argv[0] << " TABLE < CAPTURE" << endl;
+	return 1;
+}
@@ -0,0 +1,72 @@
+/*
+ * Module: cobs-decode
+ *
+ * Function: host-side decoder of COBS frames sent by USBPrinter::writeFrame()
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ *
+ * Build (Linux):
+ * 	g++ -std=c++17 -O2 -I../../src -o cobs-decode cobs-decode.cpp
+ *
+ * Decode a capture (raw bytes read from the serial port), one hexadecimal frame per line:
+ * 	cobs-decode < capture.bin
+ *
+ * Write each frame as raw bytes prefixed by its length (uint32 little-endian), e.g. for another tool:
+ * 	cobs-decode --raw < capture.bin > frames.bin
+ */
+
+#include <Cobs.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char * argv[]) {
+	bool raw = false;
+	size_t maxFrame = 65536;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--raw") == 0) {
+			raw = true;
+		} else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+			maxFrame = strtoul(argv[++i], nullptr, 10);
+		} else {
+			fprintf(stderr, "usage: cobs-decode [--raw] [--max FRAME_SIZE] < capture\n");
+			return 1;
+		}
+	}
+	vector<uint8_t> frame(maxFrame);
+	CobsDecoder decoder(frame.data(), frame.size());
+	unsigned long frames = 0, invalid = 0;
+	bool pending = false;
+	int c;
+	while ((c = getchar()) != EOF) {
+		int32_t size = decoder.put(static_cast<uint8_t>(c));
+		if (c != 0) {
+			pending = true;
+			continue;
+		}
+		if (size < 0) {
+			// empty delimiter or corrupted frame: resynchronized on this delimiter
+			if (pending) invalid++;
+		} else if (raw) {
+			uint8_t len[4] = { uint8_t(size), uint8_t(size >> 8), uint8_t(size >> 16), uint8_t(size >> 24) };
+			fwrite(len, 1, 4, stdout);
+			fwrite(decoder.data(), 1, size, stdout);
+			frames++;
+		} else {
+			for (int32_t i = 0; i < size; i++) {
+				printf("%02X", decoder.data()[i]);
+			}
+			printf("\n");
+			frames++;
+		}
+		pending = false;
+	}
+	fprintf(stderr, "%lu frames, %lu invalid\n", frames, invalid);
+	return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Module: crc-bench
+ *
+ * Function: checks and benchmarks the CRC methods of Crc.h against the bitwise version
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ *
+ * Build (Linux):
+ * 	g++ -std=c++17 -O2 -I../../src -o crc-bench crc-bench.cpp
+ *
+ * Same loop on target: call bench() from a sketch with micros() as clock
+ */
+
+#include <Crc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+static const char CHECK[] = "123456789";
+
+template <template <uint8_t> class CRC, uint8_t METHOD>
+static bool check(const char * name, uint32_t expected, const vector<uint8_t> & data) {
+	uint32_t value = CRC<METHOD>::compute(CHECK, 9);
+	// incremental update with odd chunk sizes must give the same CRC as a single pass
+	CRC<METHOD> crc;
+	for (size_t pos = 0; pos < data.size(); ) {
+		size_t chunk = 1 + rand() % 13;
+		if (pos + chunk > data.size()) chunk = data.size() - pos;
+		crc.update(&data[pos], chunk);
+		pos += chunk;
+	}
+	bool ok = (value == expected && crc.value() == CRC<CRC_BITWISE>::compute(data.data(), data.size()));
+	printf("%-12s method %d: check 0x%08X %s\n", name, METHOD, value, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+template <template <uint8_t> class CRC, uint8_t METHOD>
+static double bench(const vector<uint8_t> & data, unsigned rounds) {
+	volatile uint32_t sink = 0;
+	auto start = chrono::steady_clock::now();
+	for (unsigned i = 0; i < rounds; i++) {
+		sink = sink + CRC<METHOD>::compute(data.data(), data.size());
+	}
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return (data.size() * static_cast<double>(rounds)) / elapsed.count() / 1e6;
+}
+
+template <template <uint8_t> class CRC>
+static bool run(const char * name, uint32_t expected, const vector<uint8_t> & data) {
+	bool ok = check<CRC, CRC_BITWISE>(name, expected, data)
+		& check<CRC, CRC_NIBBLE>(name, expected, data)
+		& check<CRC, CRC_TABLE>(name, expected, data)
+		& check<CRC, CRC_SLICE4>(name, expected, data);
+	unsigned rounds = 2000;
+	double bitwise = bench<CRC, CRC_BITWISE>(data, rounds);
+	double nibble = bench<CRC, CRC_NIBBLE>(data, rounds);
+	double table = bench<CRC, CRC_TABLE>(data, rounds);
+	double slice4 = bench<CRC, CRC_SLICE4>(data, rounds);
+	printf("%-12s MB/s: bitwise %.0f, nibble %.0f (%.1fx), table %.0f (%.1fx), slice4 %.0f (%.1fx)\n", name,
+		bitwise, nibble, nibble / bitwise, table, table / bitwise, slice4, slice4 / bitwise);
+	return ok;
+}
+
+int main() {
+	vector<uint8_t> data(4096);
+	for (auto & byte: data) byte = rand();
+	bool ok = run<Crc8>("CRC-8", 0xF4, data)
+		& run<Crc16Ccitt>("CRC-16/CCITT", 0x29B1, data)
+		& run<Crc32>("CRC-32", 0xCBF43926, data);
+	return ok ? 0 : 1;
+}
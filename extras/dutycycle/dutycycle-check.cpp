@@ -0,0 +1,82 @@
+/*
+ * Module: dutycycle-check
+ *
+ * Function: checks that DutyCyclePolicy periods do not flap on noisy battery discharge curves
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ *
+ * Build (Linux):
+ * 	g++ -std=c++17 -O2 -I../host -I../../src -o dutycycle-check dutycycle-check.cpp
+ *
+ * Each curve discharges from 100% to 0% (straight line, or Li-ion plateau lingering around tier boundaries)
+ * and every reading gets a uniform noise of +/- NOISE percent:
+ * - STEP: noise below hysteresis, the period may only grow, once per tier boundary crossed
+ * - LINEAR: noise below hysteresis / 2, the period may only grow
+ */
+
+#include <DutyCyclePolicy.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+using Policy = DutyCyclePolicy<4>;
+
+static Policy makePolicy(uint8_t mode, uint8_t hysteresis) {
+	return Policy({ {50, 15*60}, {20, 60*60}, {0, 6*60*60} }, mode, hysteresis);
+}
+
+static constexpr unsigned READINGS = 20000;
+
+/*
+ * True battery level (percent) of reading i
+ */
+static double straight(unsigned i) {
+	return 100.0 * (READINGS - i) / READINGS;
+}
+
+static double plateau(unsigned i) {
+	double x = static_cast<double>(i) / READINGS;
+	// flat around 50% and 20% (the tier boundaries) during most of the discharge
+	if (x < 0.1) return 100 - x * 450;
+	if (x < 0.5) return 55 - (x - 0.1) * 25;
+	if (x < 0.6) return 45 - (x - 0.5) * 200;
+	if (x < 0.9) return 25 - (x - 0.6) * 33;
+	return 15 - (x - 0.9) * 150;
+}
+
+static bool check(const char * name, uint8_t mode, double (*curve)(unsigned), int noise, uint8_t hysteresis) {
+	srand(1);
+	Policy policy = makePolicy(mode, hysteresis);
+	uint32_t previous = policy.timeout();
+	unsigned changes = 0, decreases = 0;
+	for (unsigned i = 0; i <= READINGS; i++) {
+		int level = static_cast<int>(curve(i) + 0.5) + rand() % (2 * noise + 1) - noise;
+		level = (level < 0 ? 0 : (level > 100 ? 100 : level));
+		if (! policy.update(static_cast<uint8_t>(level)))
+			continue;
+		changes++;
+		if (policy.timeout() < previous)
+			decreases++;
+		previous = policy.timeout();
+	}
+	// STEP: 3 tiers, 2 boundaries crossed
+	bool ok = (decreases == 0 && (mode != Policy::STEP || changes == 2));
+	printf("%-6s %-8s noise +/-%d hysteresis %d: %5u changes, %u decreases %s\n",
+		mode == Policy::STEP ? "STEP" : "LINEAR", name, noise, hysteresis, changes, decreases, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main() {
+	bool ok = true;
+	for (uint8_t hysteresis: { 3, 5, 10 }) {
+		ok &= check("straight", Policy::STEP, straight, hysteresis - 1, hysteresis);
+		ok &= check("plateau", Policy::STEP, plateau, hysteresis - 1, hysteresis);
+		ok &= check("straight", Policy::LINEAR, straight, (hysteresis - 1) / 2, hysteresis);
+		ok &= check("plateau", Policy::LINEAR, plateau, (hysteresis - 1) / 2, hysteresis);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,434 @@
+/*
+ * Module: fleet-sim
+ *
+ * Function: host discrete-event simulation of a fleet of nodes, for tuning duty-cycle and energy policies
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ *
+ * Build (Linux):
+ * 	g++ -std=c++17 -O2 -pthread -I../host -I../../src -o fleet-sim fleet-sim.cpp
+ *
+ * 	fleet-sim [nodes] [days] [threads] [trace.csv] > nodes.csv
+ *
+ * Each virtual node has its own RTC, battery and input event trace, and runs the policy under test
+ * (DutyCyclePolicy tiers and currents of FleetConfig below) with stand-ins of the board classes:
+ * - SimClock: LowPowerClock (virtual RTC, PowerStats, 1 s calendar alarms, 1/1024 s LowPowerTimer)
+ * - SimTimer: ISRTimer (seconds or milliseconds timeout, source chosen by duration)
+ * - SimPin: ISRWrapper (debounce delay), accepted events are pushed into an ArrayDeque (overflow = dropped event)
+ * - SimBattery: EnergyController (charge integrated from active / standby currents, voltage -> level)
+ *
+ * Nodes do not interact: the fleet is split into small chunks taken by worker threads
+ * from a shared counter until none is left, hence fast threads take the work of slow ones
+ *
+ * trace.csv (optional): one "node,seconds" line per pin event, replaces the random trace of that node
+ *
+ * Output: one CSV line per node on stdout, fleet summary on stderr
+ */
+
+#include <ArrayDeque.h>
+#include <DutyCyclePolicy.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace leuville::simple_template_library;
+
+/*
+ * Policy and hardware figures under test
+ */
+struct FleetConfig {
+	uint16_t	vmin = 3200;				// millivolts, as EnergyController<VMIN, VMAX>
+	uint16_t	vmax = 4200;
+	double		capacityMah = 2400;			// nominal, +/- capacitySpread per node
+	double		capacitySpread = 0.10;
+	double		selfDischargePerMonth = 0.02;
+	uint32_t	activeCurrent = 10000;		// microamps
+	uint32_t	standbyCurrent = 20;		// microamps
+	uint32_t	wakeActiveMs = 150;			// timer wake-up: sample + send
+	uint32_t	warmupMs = 200;				// sensor warm-up before sampling
+	bool		warmupInStandby = true;		// ISRTimer::setTimeoutMs() instead of loopFor()
+	uint32_t	eventActiveMs = 20;			// per queued event sent
+	uint8_t		eventsPerWake = 4;			// queued events sent per timer wake-up
+	uint32_t	pinActiveMs = 5;			// pin wake-up: ISR + back to standby
+	uint32_t	pinDebounceMs = 250;		// ISRWrapper delay
+	double		pinEventsPerHour = 2;		// mean rate, per node rate drawn in [0, 2 x mean]
+};
+
+static const FleetConfig config;
+
+static DutyCyclePolicy<4> makePolicy() {
+	return DutyCyclePolicy<4>({ {50, 15*60}, {20, 60*60}, {0, 6*60*60} });
+}
+
+static constexpr uint8_t QUEUE = 8;
+
+/*
+ * xorshift64*: one independent stream per node, results do not depend on thread scheduling
+ */
+class SimRandom {
+	uint64_t	_state;
+public:
+	SimRandom(uint64_t seed): _state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+	uint64_t next() {
+		_state ^= _state >> 12;
+		_state ^= _state << 25;
+		_state ^= _state >> 27;
+		return _state * 0x2545F4914F6CDD1DULL;
+	}
+
+	double uniform() {
+		return (next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	double exponential(double mean) {
+		return -mean * log(1.0 - uniform());
+	}
+};
+
+/*
+ * LowPowerClock stand-in: virtual time in milliseconds
+ */
+struct SimClock {
+	uint64_t	nowMs = 0;
+	uint64_t	activeMs = 0;
+	uint64_t	standbyMs = 0;
+	uint32_t	alarmWakeups = 0;
+	uint32_t	timerWakeups = 0;
+	uint32_t	pinWakeups = 0;
+
+	uint32_t getEpoch() const {
+		return static_cast<uint32_t>(nowMs / 1000);
+	}
+
+	/*
+	 * RTC calendar alarm: setAlarmEpoch(getEpoch() + seconds), fires on a second boundary
+	 */
+	uint64_t alarmAt(uint32_t seconds) const {
+		return (static_cast<uint64_t>(getEpoch()) + seconds) * 1000;
+	}
+
+	/*
+	 * LowPowerTimer: ticks of 1/1024 s rounded up
+	 */
+	uint64_t timerAt(uint32_t ms) const {
+		uint64_t ticks = (static_cast<uint64_t>(ms) * 1024 + 999) / 1000;
+		return nowMs + (ticks * 1000 + 1023) / 1024;
+	}
+};
+
+/*
+ * ISRTimer stand-in: same choice of wake-up source by duration
+ */
+struct SimTimer {
+	static constexpr uint32_t MAX_MS = 63999;	// LowPowerTimer::MAX_MS
+
+	uint64_t	at = 0;
+	bool		ms = false;
+
+	void setTimeout(const SimClock & clock, uint32_t seconds) {
+		at = clock.alarmAt(seconds);
+		ms = false;
+	}
+
+	void setTimeoutMs(const SimClock & clock, uint32_t timeoutMs) {
+		ms = (timeoutMs <= MAX_MS);
+		at = (ms ? clock.timerAt(timeoutMs) : clock.alarmAt((timeoutMs + 999) / 1000));
+	}
+};
+
+/*
+ * ISRWrapper stand-in: ISR_commonCB() debounce, an accepted event is pushed by ISR_callback()
+ */
+struct SimPin {
+	uint64_t	lastMs = 0;
+	bool		any = false;
+
+	bool accept(uint64_t nowMs) {
+		if (any && nowMs < lastMs + config.pinDebounceMs)
+			return false;
+		any = true;
+		lastMs = nowMs;
+		return true;
+	}
+};
+
+/*
+ * EnergyController stand-in with a battery: charge in microamps x milliseconds
+ */
+struct SimBattery {
+	double		capacity;		// uA.ms
+	double		charge = 0;		// consumed
+	double		selfCurrent;	// self-discharge as a constant current (uA)
+
+	SimBattery(double capacityMah)
+		: capacity(capacityMah * 3.6e9), selfCurrent(capacityMah * 1000 * config.selfDischargePerMonth / (30 * 24)) {}
+
+	void draw(uint64_t ms, uint32_t current) {
+		charge += ms * (current + selfCurrent);
+	}
+
+	bool empty() const {
+		return charge >= capacity;
+	}
+
+	/*
+	 * Li-ion discharge curve: flat between 90% and 10%, steep at both ends
+	 */
+	uint16_t voltage() const {
+		double soc = 1.0 - charge / capacity;
+		if (soc < 0) soc = 0;
+		double shape;
+		if (soc > 0.9)
+			shape = 0.85 + (soc - 0.9) * 1.5;
+		else if (soc > 0.1)
+			shape = 0.25 + (soc - 0.1) * 0.75;
+		else
+			shape = soc * 2.5;
+		return static_cast<uint16_t>(config.vmin + shape * (config.vmax - config.vmin));
+	}
+
+	/*
+	 * EnergyController::getBatteryPower<uint8_t>(0, 100)
+	 */
+	uint8_t level() const {
+		return scaleValue(voltage(), config.vmin, config.vmax, static_cast<uint8_t>(0), static_cast<uint8_t>(100));
+	}
+};
+
+/*
+ * Input event trace of one node: recorded times, or Poisson arrivals
+ */
+struct SimTrace {
+	const vector<uint64_t> *	recorded = nullptr;
+	size_t						index = 0;
+	double						meanMs = 0;		// 0 = no random events
+	SimRandom &					random;
+	uint64_t					last = 0;
+
+	SimTrace(SimRandom & random): random(random) {}
+
+	uint64_t next() {
+		if (recorded != nullptr)
+			return (index < recorded->size() ? (*recorded)[index++] : UINT64_MAX);
+		if (meanMs == 0)
+			return UINT64_MAX;
+		last += 1 + static_cast<uint64_t>(random.exponential(meanMs));
+		return last;
+	}
+};
+
+struct NodeResult {
+	double		capacityMah;
+	double		lifetimeDays;	// < 0: alive at the end of the simulation
+	uint32_t	alarmWakeups;
+	uint32_t	timerWakeups;
+	uint32_t	pinWakeups;
+	uint32_t	events;
+	uint32_t	sent;
+	uint32_t	dropped;
+	uint8_t		level;
+	double		activeHours;
+	uint64_t	simEvents;
+};
+
+/*
+ * Runs one node from time 0 until end or empty battery
+ */
+static NodeResult simulateNode(uint32_t node, uint64_t endMs, const vector<uint64_t> * recorded) {
+	SimRandom random(node + 1);
+	SimClock clock;
+	SimBattery battery(config.capacityMah * (1 + config.capacitySpread * (2 * random.uniform() - 1)));
+	auto policy = makePolicy();
+	ArrayDeque<uint32_t, NoLock, QUEUE> queue;	// ISR_callback() -> loop()
+
+	SimTrace trace(random);
+	trace.recorded = recorded;
+	double rate = config.pinEventsPerHour * 2 * random.uniform();
+	trace.meanMs = (rate > 0 ? 3600000.0 / rate : 0);
+
+	NodeResult res {};
+	res.capacityMah = battery.capacity / 3.6e9;
+	res.lifetimeDays = -1;
+
+	enum Phase : uint8_t { SAMPLE, WARMUP };
+	Phase phase = SAMPLE;
+	SimTimer timer;
+	timer.setTimeout(clock, policy.timeout());
+	SimPin pin;
+	uint64_t pinAt = trace.next();
+	uint64_t busyUntil = 0;		// end of the current active period, energy accounted until this time
+
+	// active period starting at the current event, or extending the current one
+	auto run = [&](uint64_t ms) {
+		battery.draw(ms, config.activeCurrent);
+		clock.activeMs += ms;
+		busyUntil += ms;
+	};
+
+	while (! battery.empty()) {
+		uint64_t next = min(timer.at, pinAt);
+		if (next >= endMs)
+			break;
+		// events are handled at their own time, also while the node is awake
+		bool wake = (next > busyUntil);
+		if (wake) {
+			battery.draw(next - busyUntil, config.standbyCurrent);
+			clock.standbyMs += next - busyUntil;
+			busyUntil = next;
+		}
+		clock.nowMs = next;
+		res.simEvents++;
+
+		if (pinAt <= timer.at) {
+			pinAt = trace.next();
+			if (! pin.accept(clock.nowMs))
+				continue;
+			res.events++;
+			if (! queue.push_back(res.events))
+				res.dropped++;
+			if (wake) {
+				clock.pinWakeups++;
+				run(config.pinActiveMs);
+			}
+			continue;
+		}
+
+		// ISRTimer::ISR_timer(): next timeout set at interrupt time
+		if (timer.ms)
+			clock.timerWakeups++;
+		else
+			clock.alarmWakeups++;
+		if (phase == SAMPLE && config.warmupMs > 0) {
+			// sensor powered on, then standby or busy wait
+			if (config.warmupInStandby) {
+				run(1);
+				phase = WARMUP;
+				timer.setTimeoutMs(clock, config.warmupMs);
+				continue;
+			}
+			run(config.warmupMs);
+		}
+		phase = SAMPLE;
+		policy.update(battery.level());
+		timer.setTimeout(clock, policy.timeout());
+		uint8_t count = 0;
+		uint32_t event;
+		while (count < config.eventsPerWake && queue.pop_front(event)) {
+			count++;
+		}
+		res.sent += count;
+		run(config.wakeActiveMs + count * config.eventActiveMs);
+	}
+
+	if (battery.empty())
+		res.lifetimeDays = clock.nowMs / 86400000.0;
+	res.alarmWakeups = clock.alarmWakeups;
+	res.timerWakeups = clock.timerWakeups;
+	res.pinWakeups = clock.pinWakeups;
+	res.level = battery.level();
+	res.activeHours = clock.activeMs / 3600000.0;
+	return res;
+}
+
+/*
+ * "node,seconds" lines, node numbers wrap on the fleet size
+ */
+static bool loadTrace(const char * path, uint32_t nodes, vector<vector<uint64_t>> & traces) {
+	FILE * file = fopen(path, "r");
+	if (file == nullptr)
+		return false;
+	traces.assign(nodes, {});
+	unsigned long node;
+	double seconds;
+	while (fscanf(file, "%lu,%lf", &node, &seconds) == 2) {
+		traces[node % nodes].push_back(static_cast<uint64_t>(seconds * 1000));
+	}
+	fclose(file);
+	for (auto & trace: traces) {
+		sort(trace.begin(), trace.end());
+	}
+	return true;
+}
+
+int main(int argc, char * argv[]) {
+	uint32_t nodes = (argc > 1 ? atoi(argv[1]) : 1000);
+	double days = (argc > 2 ? atof(argv[2]) : 365);
+	unsigned threads = (argc > 3 ? atoi(argv[3]) : 0);
+	if (threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+
+	vector<vector<uint64_t>> traces;
+	if (argc > 4 && ! loadTrace(argv[4], nodes, traces)) {
+		fprintf(stderr, "cannot read %s\n", argv[4]);
+		return 1;
+	}
+
+	uint64_t endMs = static_cast<uint64_t>(days * 86400000.0);
+	vector<NodeResult> results(nodes);
+	static constexpr uint32_t CHUNK = 16;
+	atomic<uint32_t> nextChunk(0);
+
+	auto start = chrono::steady_clock::now();
+	vector<thread> workers;
+	for (unsigned t = 0; t < threads; t++) {
+		workers.emplace_back([&]() {
+			for (;;) {
+				uint32_t first = nextChunk.fetch_add(CHUNK);
+				if (first >= nodes)
+					break;
+				uint32_t last = min(nodes, first + CHUNK);
+				for (uint32_t node = first; node < last; node++) {
+					// nodes missing from the trace file keep their random trace
+					results[node] = simulateNode(node, endMs, (traces.empty() || traces[node].empty()) ? nullptr : &traces[node]);
+				}
+			}
+		});
+	}
+	for (auto & worker: workers) {
+		worker.join();
+	}
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	printf("node,capacity_mah,lifetime_days,alarm_wakeups,timer_wakeups,pin_wakeups,events,sent,dropped,level,active_hours\n");
+	vector<double> lifetimes;
+	uint64_t simEvents = 0, wakeups = 0, events = 0, dropped = 0;
+	for (uint32_t node = 0; node < nodes; node++) {
+		const NodeResult & res = results[node];
+		if (res.lifetimeDays >= 0) {
+			lifetimes.push_back(res.lifetimeDays);
+			printf("%u,%.0f,%.2f,", node, res.capacityMah, res.lifetimeDays);
+		} else {
+			printf("%u,%.0f,,", node, res.capacityMah);
+		}
+		printf("%u,%u,%u,%u,%u,%u,%u,%.2f\n", res.alarmWakeups, res.timerWakeups, res.pinWakeups,
+			res.events, res.sent, res.dropped, res.level, res.activeHours);
+		simEvents += res.simEvents;
+		wakeups += res.alarmWakeups + res.timerWakeups + res.pinWakeups;
+		events += res.events;
+		dropped += res.dropped;
+	}
+
+	fprintf(stderr, "%u nodes, %.0f days, %u threads: %.2f s, %.1f M events/s\n",
+		nodes, days, threads, elapsed, simEvents / elapsed / 1e6);
+	fprintf(stderr, "wake-ups: %llu, pin events: %llu, dropped: %llu (%.2f%%)\n",
+		(unsigned long long)wakeups, (unsigned long long)events, (unsigned long long)dropped,
+		events ? 100.0 * dropped / events : 0.0);
+	if (lifetimes.empty()) {
+		fprintf(stderr, "no battery empty\n");
+	} else {
+		sort(lifetimes.begin(), lifetimes.end());
+		fprintf(stderr, "battery empty: %zu nodes, lifetime min %.1f / median %.1f / max %.1f days\n",
+			lifetimes.size(), lifetimes.front(), lifetimes[lifetimes.size() / 2], lifetimes.back());
+	}
+	return 0;
+}
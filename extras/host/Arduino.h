@@ -0,0 +1,39 @@
+/*
+ * Minimal Arduino.h shared by the host tools of extras (mpsc-stress, fleet-sim): interrupt masking is a no-op,
+ * concurrency comes from threads and compareExchange() uses the host atomics
+ * GPIO is simulated (pin levels in RAM), GpioPin / PortMasks of FastGpio.h count writes per pin (GpioTraffic)
+ *
+ * 	g++ -std=c++17 -I../host -I../../src ...
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <chrono>
+
+inline unsigned long micros() {
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t __get_PRIMASK() { return 0; }
+inline void __disable_irq() {}
+inline void __set_PRIMASK(uint32_t) {}
+
+#define GPIO_TRAFFIC_PINS 64
+
+#define LOW		0
+#define HIGH	1
+#define INPUT	0
+#define OUTPUT	1
+
+inline uint8_t & hostPinLevel(uint8_t pin) {
+	static uint8_t levels[256] = {};
+	return levels[pin];
+}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) { hostPinLevel(pin) = (value != LOW); }
+inline int digitalRead(uint8_t pin) { return hostPinLevel(pin); }
@@ -0,0 +1,94 @@
+/*
+ * Module: mpsc-stress
+ *
+ * Function: host stress test of MpscQueue, threads stand in for preempting ISRs
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ *
+ * Build (Linux):
+ * 	g++ -std=c++17 -O2 -pthread -I../host -I../../src -o mpsc-stress mpsc-stress.cpp
+ *
+ * 	mpsc-stress [producers] [pushes per producer]
+ *
+ * Producers retry when the queue is full (an ISR would drop the event)
+ * Checks that every element is delivered exactly once and in order for each producer
+ */
+
+#include <MpscQueue.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace leuville::simple_template_library;
+
+struct Event {
+	uint8_t		producer;
+	uint32_t	counter;
+};
+
+int main(int argc, char * argv[]) {
+	unsigned producers = (argc > 1 ? atoi(argv[1]) : 4);
+	uint32_t pushes = (argc > 2 ? atoi(argv[2]) : 1000000);
+
+	static MpscQueue<Event, 16> queue;
+	vector<uint64_t> accepted(producers, 0);
+	atomic<unsigned> running(producers);
+
+	auto start = chrono::steady_clock::now();
+	vector<thread> threads;
+	for (unsigned p = 0; p < producers; p++) {
+		threads.emplace_back([&, p]() {
+			for (uint32_t i = 0; i < pushes; i++) {
+				while (! queue.push({ static_cast<uint8_t>(p), i })) {
+					this_thread::yield();
+				}
+				accepted[p]++;
+			}
+			running--;
+		});
+	}
+
+	// consumer: loop()
+	vector<int64_t> last(producers, -1);
+	vector<uint64_t> received(producers, 0);
+	bool ok = true;
+	Event event;
+	for (;;) {
+		bool finished = (running == 0);
+		while (queue.pop(event)) {
+			if (event.producer >= producers || static_cast<int64_t>(event.counter) <= last[event.producer]) {
+				printf("out of order: producer %u counter %u after %lld\n", event.producer, event.counter,
+					static_cast<long long>(event.producer < producers ? last[event.producer] : -1));
+				ok = false;
+			} else {
+				last[event.producer] = event.counter;
+				received[event.producer]++;
+			}
+		}
+		if (finished)
+			break;
+		this_thread::yield();
+	}
+	for (auto & thread: threads) thread.join();
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+	uint64_t total = 0;
+	for (unsigned p = 0; p < producers; p++) {
+		if (received[p] != accepted[p]) {
+			printf("producer %u: %llu accepted, %llu received\n", p,
+				static_cast<unsigned long long>(accepted[p]), static_cast<unsigned long long>(received[p]));
+			ok = false;
+		}
+		total += received[p];
+	}
+	printf("%u producers: %llu delivered, %u retries (queue full), %.1f Mevents/s: %s\n", producers,
+		static_cast<unsigned long long>(total), queue.dropped(), total / elapsed.count() / 1e6, ok ? "ok" : "FAILED");
+	return ok && queue.empty() ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+/*
+ * Module: payload-codec
+ *
+ * Function: host-side encoder / decoder of BitPayload frames
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ *
+ * Build (Linux):
+ * 	g++ -std=c++17 -O2 -I../../src -o payload-codec payload-codec.cpp
+ *
+ * Fields are given as min:max:resolution, in the order of the layout
+ *
+ * Decode frames (one hexadecimal frame per line) into CSV values:
+ * 	payload-codec [--delta] -40:85:0.1 0:100:0.5 3:4.2:0.01 < frames.txt
+ *
+ * Encode CSV values into frames (round-trip tests):
+ * 	payload-codec --encode [--delta] [--keyframe N] -40:85:0.1 0:100:0.5 3:4.2:0.01 < values.csv
+ */
+
+#include <BitPayload.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static bool parseField(const char * arg, vector<PayloadField> & fields) {
+	float min, max, resolution;
+	if (sscanf(arg, "%f:%f:%f", &min, &max, &resolution) != 3 || resolution <= 0 || max <= min)
+		return false;
+	fields.push_back(PayloadField(min, max, resolution));
+	return true;
+}
+
+static int encode(const vector<PayloadField> & fields, bool delta, unsigned keyframe) {
+	vector<uint32_t> steps(fields.size()), previous(fields.size());
+	vector<uint8_t> buffer(256);
+	bool hasPrevious = false;
+	unsigned sinceKeyframe = 0;
+	uint16_t bits = 0;
+	for (auto & field: fields) bits += field.bits();
+	uint8_t capacity = (bits + (delta ? 1 : 0) + 7) / 8;
+	string line;
+	while (getline(cin, line)) {
+		if (line.empty())
+			continue;
+		istringstream in(line);
+		string value;
+		for (size_t i = 0; i < fields.size(); i++) {
+			if (! getline(in, value, ',')) {
+				cerr << "missing value: " << line << endl;
+				return 1;
+			}
+			steps[i] = fields[i].quantize(strtof(value.c_str(), nullptr));
+		}
+		uint8_t len = 0;
+		if (delta && hasPrevious && (keyframe == 0 || sinceKeyframe + 1 < keyframe)) {
+			len = payloadEncode(fields.data(), fields.size(), steps.data(), true, previous.data(), buffer.data(), capacity);
+		}
+		if (len == 0) {
+			len = payloadEncode(fields.data(), fields.size(), steps.data(), delta, nullptr, buffer.data(), capacity);
+			sinceKeyframe = 0;
+		} else {
+			sinceKeyframe++;
+		}
+		for (uint8_t i = 0; i < len; i++) {
+			printf("%02X", buffer[i]);
+		}
+		printf("\n");
+		previous = steps;
+		hasPrevious = true;
+	}
+	return 0;
+}
+
+static int decode(const vector<PayloadField> & fields, bool delta) {
+	vector<uint32_t> steps(fields.size()), previous(fields.size());
+	bool hasPrevious = false;
+	string line;
+	while (getline(cin, line)) {
+		vector<uint8_t> frame;
+		for (size_t i = 0; i + 1 < line.size(); i += 2) {
+			frame.push_back(static_cast<uint8_t>(strtoul(line.substr(i, 2).c_str(), nullptr, 16)));
+		}
+		if (frame.empty())
+			continue;
+		if (! payloadDecode(fields.data(), fields.size(), frame.data(), frame.size(), steps.data(),
+							delta ? previous.data() : nullptr, hasPrevious)) {
+			// delta frames are useless until the next absolute frame
+			printf("# invalid frame %s\n", line.c_str());
+			hasPrevious = false;
+			continue;
+		}
+		for (size_t i = 0; i < fields.size(); i++) {
+			printf("%s%g", i > 0 ? "," : "", fields[i].dequantize(steps[i]));
+		}
+		printf("\n");
+		previous = steps;
+		hasPrevious = true;
+	}
+	return 0;
+}
+
+int main(int argc, char * argv[]) {
+	vector<PayloadField> fields;
+	bool encoding = false, delta = false;
+	unsigned keyframe = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--encode") == 0) {
+			encoding = true;
+		} else if (strcmp(argv[i], "--delta") == 0) {
+			delta = true;
+		} else if (strcmp(argv[i], "--keyframe") == 0 && i + 1 < argc) {
+			keyframe = atoi(argv[++i]);
+		} else if (! parseField(argv[i], fields)) {
+			cerr << "invalid field: " << argv[i] << " (expected min:max:resolution)" << endl;
+			return 1;
+		}
+	}
+	if (fields.empty()) {
+		cerr << "usage: payload-codec [--encode] [--delta] [--keyframe N] min:max:resolution..." << endl;
+		return 1;
+	}
+	return (encoding ? encode(fields, delta, keyframe) : decode(fields, delta));
+}
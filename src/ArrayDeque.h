@@ -1,19 +1,23 @@
 #pragma once
 
 #include <Arduino.h>
+#include <CriticalSection.h>
 
 namespace leuville {
 namespace simple_template_library {
 
 /*
- * Fixed-size deque (fifo) implemented with a circular array. 
- * 
- * if SYNC is true, the object is protected against interrupts
+ * Fixed-size deque (fifo) implemented with a circular array.
+ *
+ * LOCK is the policy protecting the object against interrupts (see CriticalSection.h)
+ * each operation runs as a whole in one critical section
  */
-template <typename T, bool SYNC = false, uint8_t SIZ = 20>
+template <typename T, typename LOCK = NoLock, uint8_t SIZ = 20>
 class ArrayDeque {
 protected:
 
+    using Guard = LockGuard<LOCK>;
+
     T _data[SIZ];
     int8_t _front = SIZ-1;
     int8_t _back = 0;
@@ -28,22 +32,48 @@ protected:
             pos = 0;
     }
 
+    /*
+     * following functions must be called inside a critical section
+     */
+
     bool isRoomAvailable() {
-        if (full()) {
+        if (_size == SIZ) {
             switch (_fullPolicy) {
-                case KEEP_FRONT: 
-                    pop_back(); 
+                case KEEP_FRONT:
+                    removeBack();
                     return true;
-                case KEEP_BACK: 
-                    pop_front(); 
+                case KEEP_BACK:
+                    removeFront();
                     return true;
-                case BLOCK: 
+                case BLOCK:
                     return false;
             }
         }
         return true;
     }
 
+    int8_t frontPos() const {
+        int8_t pos = _front;
+        shift(pos, +1);
+        return pos;
+    }
+
+    int8_t backPos() const {
+        int8_t pos = _back;
+        shift(pos, -1);
+        return pos;
+    }
+
+    void removeFront() {
+        shift(_front, +1);
+        _size--;
+    }
+
+    void removeBack() {
+        shift(_back, -1);
+        _size--;
+    }
+
 public:
 
     /*
@@ -60,102 +90,101 @@ public:
         return SIZ;
     }
 
+    /*
+     * size is one byte: read without critical section
+     */
     uint8_t size() const {
         return _size;
     }
 
     bool empty() const {
-        if (SYNC) noInterrupts();
-        bool res = (size() == 0);
-        if (SYNC) interrupts();
-        return res;
+        return (_size == 0);
     }
 
     bool full() const {
-        if (SYNC) noInterrupts();
-        bool res = (_size == SIZ);
-        if (SYNC) interrupts();
-        return res;
+        return (_size == SIZ);
     }
 
     bool push_front(const T& elt) {
+        Guard guard;
         if (! isRoomAvailable()) {
             return false;
         }
-        if (SYNC) noInterrupts();
         _data[_front] = elt;
         shift(_front, -1);
         _size++;
-        if (SYNC) interrupts();
         return true;
     }
 
     bool push_back(const T& elt) {
+        Guard guard;
         if (! isRoomAvailable()) {
             return false;
         }
-        if (SYNC) noInterrupts();
         _data[_back] = elt;
         shift(_back, +1);
         _size++;
-        if (SYNC) interrupts();
         return true;
     }
 
     const T& front() const {
-        if (SYNC) noInterrupts();
-        int8_t pos = _front;
-        shift(pos, +1);
-        const T& res = _data[pos];
-        if (SYNC) interrupts();
-        return res;
+        Guard guard;
+        return _data[frontPos()];
     }
 
     const T& back() const {
-        if (SYNC) noInterrupts();
-        int8_t pos = _back;
-        shift(pos, -1);
-        const T& res = _data[pos];
-        if (SYNC) interrupts();
-        return res;
+        Guard guard;
+        return _data[backPos()];
     }
 
     T* frontPtr() {
+        Guard guard;
         if (_size == 0)
             return nullptr;
-        if (SYNC) noInterrupts();
-        int8_t pos = _front;
-        shift(pos, +1);
-        T* res = & _data[pos];
-        if (SYNC) interrupts();
-        return res;
+        return & _data[frontPos()];
     }
 
     T* backPtr() {
+        Guard guard;
         if (_size == 0)
             return nullptr;
-        if (SYNC) noInterrupts();
-        int8_t pos = _back;
-        shift(pos, -1);
-        T* res = & _data[pos];
-        if (SYNC) interrupts();
-        return res;
+        return & _data[backPos()];
     }
 
     void pop_front() {
-        if (SYNC) noInterrupts();
-        shift(_front, +1);
-        _size--;
-        if (SYNC) interrupts();
+        Guard guard;
+        if (_size > 0)
+            removeFront();
     }
 
     void pop_back() {
-        if (SYNC) noInterrupts();
-        shift(_back, -1);
-        _size--;
-        if (SYNC) interrupts();
+        Guard guard;
+        if (_size > 0)
+            removeBack();
     }
-    
+
+    /*
+     * Copies then removes front element in the same critical section
+     * returns false if empty
+     */
+    bool pop_front(T& elt) {
+        Guard guard;
+        if (_size == 0)
+            return false;
+        elt = _data[frontPos()];
+        removeFront();
+        return true;
+    }
+
+    bool pop_back(T& elt) {
+        Guard guard;
+        if (_size == 0)
+            return false;
+        elt = _data[backPos()];
+        removeBack();
+        return true;
+    }
+
 };
 
 }
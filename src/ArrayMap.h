@@ -1,65 +1,230 @@
 #pragma once
 
 #include <Arduino.h>
+#include <new>
+#include <CriticalSection.h>
 
 namespace leuville {
 namespace simple_template_library {
 
-#define NO_INTERRUPT_IF(SYNC) if constexpr(SYNC) noInterrupts()
-#define INTERRUPT_IF(SYNC) if constexpr(SYNC) interrupts()
-
 /*
- * Fixed-size map
+ * Storage layout of ArrayMap
+ * PAIRS = array of (key, value) pairs
+ * SPLIT = keys and values in two separate arrays: lookups only touch keys
+ * (contiguous integer keys allow the compiler to unroll or vectorize the scan)
  */
-template <typename K = String, typename V = uint8_t, bool SYNC = false, uint8_t SIZ = 20>
-class ArrayMap
-{
+enum class ArrayMapLayout : uint8_t { PAIRS, SPLIT };
+
+template <typename K, typename V, uint8_t SIZ, ArrayMapLayout LAYOUT>
+struct ArrayMapStorage;
+
+template <typename K, typename V, uint8_t SIZ>
+struct ArrayMapStorage<K, V, SIZ, ArrayMapLayout::PAIRS> {
     struct Pair {
         K _key;
         V _value;
     };
 
     Pair _data[SIZ];
-    uint8_t _size = 0;
 
-    Pair* get(const K & key) {
-        for (uint8_t i = 0; i < _size; i++) {
-            Pair & pair = _data[i];
-            if (pair._key == key)
-                return &pair;
+    K & key(uint8_t pos) { return _data[pos]._key; }
+    V & value(uint8_t pos) { return _data[pos]._value; }
+
+    int16_t indexOf(const K & key, uint8_t size) const {
+        for (uint8_t i = 0; i < size; i++) {
+            if (_data[i]._key == key)
+                return i;
         }
-        return nullptr;
+        return -1;
     }
+};
+
+template <typename K, typename V, uint8_t SIZ>
+struct ArrayMapStorage<K, V, SIZ, ArrayMapLayout::SPLIT> {
+    K _keys[SIZ];
+    V _values[SIZ];
+
+    K & key(uint8_t pos) { return _keys[pos]; }
+    V & value(uint8_t pos) { return _values[pos]; }
+
+    int16_t indexOf(const K & key, uint8_t size) const {
+        const K* keys = _keys;
+        for (uint8_t i = 0; i < size; i++) {
+            if (keys[i] == key)
+                return i;
+        }
+        return -1;
+    }
+};
 
+/*
+ * Fixed-size map
+ *
+ * LOCK is the policy protecting the object against interrupts (see CriticalSection.h)
+ * iteration is not protected: take a LockGuard<LOCK> around the loop if the map is shared with an ISR
+ *
+ * remove() moves the last entry into the freed position: positions are not stable
+ * freed positions are reset to default key and value (heap memory of String keys is released)
+ */
+template <typename K = String, typename V = uint8_t, typename LOCK = NoLock, uint8_t SIZ = 20,
+          ArrayMapLayout LAYOUT = ArrayMapLayout::PAIRS>
+class ArrayMap
+{
+    using Guard = LockGuard<LOCK>;
+
+    ArrayMapStorage<K, V, SIZ, LAYOUT> _storage;
+    uint8_t _size = 0;
+
+    /*
+     * Destroys and rebuilds obj (assignment may keep the buffer of a String)
+     */
+    template <typename T>
+    static void release(T & obj) {
+        obj.~T();
+        new (&obj) T();
+    }
+
+    void releaseAt(uint8_t pos) {
+        release(_storage.key(pos));
+        release(_storage.value(pos));
+    }
+
+    public:
+
+    /*
+     * Iterated element: references to key and value
+     */
+    struct Entry {
+        const K & key;
+        V & value;
+    };
+
+    class iterator {
+        ArrayMap* _map;
+        uint8_t _pos;
     public:
-    
+        iterator(ArrayMap* map, uint8_t pos): _map(map), _pos(pos) {}
+        Entry operator*() const { return { _map->key(_pos), _map->value(_pos) }; }
+        iterator & operator++() { _pos++; return *this; }
+        bool operator!=(const iterator & other) const { return _pos != other._pos; }
+        bool operator==(const iterator & other) const { return _pos == other._pos; }
+    };
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, _size);
+    }
+
+    constexpr uint8_t max_size() const {
+        return SIZ;
+    }
+
+    uint8_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return (_size == 0);
+    }
+
+    bool full() const {
+        return (_size == SIZ);
+    }
+
     bool put(const K key, const V value) {
-        if (_size == SIZ)
-            return false;
-        Pair* pair = get(key);
-        NO_INTERRUPT_IF(SYNC);
-        if (pair == nullptr) {
-            _data[_size++] = { key, value };
+        Guard guard;
+        int16_t pos = _storage.indexOf(key, _size);
+        if (pos >= 0) {
+            _storage.value(pos) = value;
+        } else if (_size < SIZ) {
+            _storage.key(_size) = key;
+            _storage.value(_size) = value;
+            _size++;
         } else {
-            pair->_value = value;    
-        }  
-        INTERRUPT_IF(SYNC); 
-        return true; 
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Pointer to the value associated with key, nullptr if not found
+     */
+    V * find(const K & key) {
+        Guard guard;
+        int16_t pos = _storage.indexOf(key, _size);
+        return (pos < 0 ? nullptr : & _storage.value(pos));
+    }
+
+    bool contains(const K & key) const {
+        Guard guard;
+        return _storage.indexOf(key, _size) >= 0;
+    }
+
+    /*
+     * Pointer to the value associated with key, inserted with default value if not found
+     * nullptr if not found and the map is full
+     */
+    V * findOrInsert(const K & key) {
+        Guard guard;
+        int16_t pos = _storage.indexOf(key, _size);
+        if (pos >= 0)
+            return & _storage.value(pos);
+        if (_size == SIZ)
+            return nullptr;
+        _storage.key(_size) = key;
+        _storage.value(_size) = V();
+        return & _storage.value(_size++);
     }
 
+    /*
+     * Value associated with key, inserted with default value if not found (as std::map)
+     * if the map is full, returns a shared sentinel that is not stored in the map:
+     * use findOrInsert() when the insertion failure must be detected
+     */
     V & operator[](const K & key) {
-        Pair* pair = get(key);
-        return pair->_value;
+        V * value = findOrInsert(key);
+        if (value != nullptr)
+            return *value;
+        static V sentinel;
+        sentinel = V();
+        return sentinel;
+    }
+
+    /*
+     * Removes key, the last entry takes its position
+     * returns false if not found
+     */
+    bool remove(const K & key) {
+        Guard guard;
+        int16_t pos = _storage.indexOf(key, _size);
+        if (pos < 0)
+            return false;
+        uint8_t last = --_size;
+        if (pos != last) {
+            _storage.key(pos) = _storage.key(last);
+            _storage.value(pos) = _storage.value(last);
+        }
+        releaseAt(last);
+        return true;
+    }
+
+    void clear() {
+        Guard guard;
+        for (uint8_t i = 0; i < _size; i++) {
+            releaseAt(i);
+        }
+        _size = 0;
     }
 
     K & key(uint8_t pos) {
-        Pair &pair = _data[pos];
-        return pair._key;
+        return _storage.key(pos);
     }
 
     V & value(uint8_t pos) {
-        Pair &pair = _data[pos];
-        return pair._value;
+        return _storage.value(pos);
     }
 };
 
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <Arduino.h>
+#include <new>
+#include <utility>
+#include <CriticalSection.h>
+
+namespace leuville {
+namespace simple_template_library {
+
+/*
+ * Fixed-size pool of SIZ blocks of T, without heap allocation.
+ *
+ * allocate() / release() are O(1) and may be called from ISR or main loop:
+ * the free list head is a single word (free index, used count, ABA tag) updated with compareExchange()
+ *
+ * Blocks are identified by a one byte Handle, which may be carried by queues
+ * instead of the object itself (see PoolHandle)
+ */
+template <typename T, uint8_t SIZ = 16>
+class ArrayPool {
+
+	static_assert(SIZ < 255, "SIZ must be less than 255");
+
+public:
+
+	using Handle = uint8_t;
+	static constexpr Handle NO_HANDLE = 0xFF;
+
+protected:
+
+	/*
+	 * _head layout: bits 0-7 first free block, bits 8-15 used blocks, bits 16-31 tag
+	 */
+	static uint32_t pack(uint8_t index, uint8_t used, uint16_t tag) {
+		return index | (static_cast<uint32_t>(used) << 8) | (static_cast<uint32_t>(tag) << 16);
+	}
+
+	alignas(T) uint8_t	_storage[SIZ][sizeof(T)];
+	volatile uint8_t	_next[SIZ];			// free list links
+	volatile uint32_t	_head = 0;
+	volatile uint8_t	_highWater = 0;
+	volatile uint32_t	_failures = 0;
+
+	void updateHighWater(uint8_t used) {
+		uint8_t highWater = _highWater;
+		while (used > highWater && ! compareExchange<uint8_t>(_highWater, highWater, used)) {}
+	}
+
+public:
+
+	ArrayPool() {
+		for (uint8_t i = 0; i < SIZ; i++) {
+			_next[i] = (i + 1 < SIZ ? i + 1 : NO_HANDLE);
+		}
+		_head = pack(SIZ > 0 ? 0 : NO_HANDLE, 0, 0);
+	}
+
+	ArrayPool(const ArrayPool &) = delete;
+	ArrayPool & operator=(const ArrayPool &) = delete;
+
+	constexpr uint8_t max_size() const {
+		return SIZ;
+	}
+
+	/*
+	 * Reserves a block, without constructing T
+	 * returns NO_HANDLE if the pool is exhausted
+	 */
+	Handle allocate() {
+		uint32_t head = _head;
+		uint8_t index, used;
+		do {
+			index = head & 0xFF;
+			if (index == NO_HANDLE) {
+				uint32_t failures = _failures;
+				while (! compareExchange<uint32_t>(_failures, failures, failures + 1)) {}
+				return NO_HANDLE;
+			}
+			used = (head >> 8) + 1;
+		} while (! compareExchange<uint32_t>(_head, head, pack(_next[index], used, (head >> 16) + 1)));
+		updateHighWater(used);
+		return index;
+	}
+
+	/*
+	 * Gives back a block obtained by allocate(), without destroying T
+	 * NO_HANDLE (failed allocate()) and out of range handles are ignored
+	 */
+	void release(Handle index) {
+		if (index >= SIZ)
+			return;
+		uint32_t head = _head;
+		do {
+			_next[index] = head & 0xFF;
+		} while (! compareExchange<uint32_t>(_head, head, pack(index, (head >> 8) - 1, (head >> 16) + 1)));
+	}
+
+	/*
+	 * allocate() + T constructor
+	 */
+	template <typename... Args>
+	Handle create(Args&&... args) {
+		Handle index = allocate();
+		if (index != NO_HANDLE) {
+			new (_storage[index]) T(std::forward<Args>(args)...);
+		}
+		return index;
+	}
+
+	/*
+	 * T destructor + release(), NO_HANDLE (failed create()) is ignored
+	 */
+	void destroy(Handle index) {
+		if (index >= SIZ)
+			return;
+		get(index)->~T();
+		release(index);
+	}
+
+	T* get(Handle index) {
+		return reinterpret_cast<T*>(_storage[index]);
+	}
+
+	T& operator[](Handle index) {
+		return *get(index);
+	}
+
+	/*
+	 * Statistics
+	 */
+	uint8_t used() const {
+		return (_head >> 8) & 0xFF;
+	}
+
+	uint8_t available() const {
+		return SIZ - used();
+	}
+
+	uint8_t highWaterMark() const {
+		return _highWater;
+	}
+
+	uint32_t failures() const {
+		return _failures;
+	}
+};
+
+/*
+ * One byte reference to an object of a global ArrayPool
+ * may be pushed into an ArrayDeque instead of the object itself
+ *
+ * 	ArrayPool<Message, 8> messages;
+ * 	ArrayDeque<PoolHandle<messages>, PrimaskLock> queue;
+ *
+ * 	ISR:	queue.push_back(PoolHandle<messages>::create(payload));
+ * 	loop:	PoolHandle<messages> msg; if (queue.pop_front(msg)) { use(*msg); msg.destroy(); }
+ */
+template <auto & POOL>
+class PoolHandle {
+
+	using Pool = typename std::remove_reference<decltype(POOL)>::type;
+	using Handle = typename Pool::Handle;
+
+	Handle _index = Pool::NO_HANDLE;
+
+public:
+
+	PoolHandle() = default;
+
+	explicit PoolHandle(Handle index): _index(index) {}
+
+	template <typename... Args>
+	static PoolHandle create(Args&&... args) {
+		return PoolHandle(POOL.create(std::forward<Args>(args)...));
+	}
+
+	/*
+	 * Destroys the object and releases its block, handle becomes invalid
+	 */
+	void destroy() {
+		if (_index != Pool::NO_HANDLE) {
+			POOL.destroy(_index);
+			_index = Pool::NO_HANDLE;
+		}
+	}
+
+	Handle index() const {
+		return _index;
+	}
+
+	explicit operator bool() const {
+		return _index != Pool::NO_HANDLE;
+	}
+
+	auto* operator->() const {
+		return POOL.get(_index);
+	}
+
+	auto& operator*() const {
+		return *POOL.get(_index);
+	}
+};
+
+}
+}
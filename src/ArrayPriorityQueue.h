@@ -0,0 +1,265 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include <CriticalSection.h>
+
+namespace leuville {
+namespace simple_template_library {
+
+/*
+ * Fixed-size priority queue implemented with a binary heap.
+ *
+ * COMPARE(a, b) is true if a comes out before b (std::less = smallest first, e.g. deadlines)
+ *
+ * push() returns a handle which remains valid until the element is popped or removed,
+ * it allows update (decrease/increase key) and remove in O(log n)
+ * a handle is made of a slot and of the generation of the slot, incremented when the element leaves it:
+ * a handle kept after pop() or remove() is rejected, even if its slot holds a new element
+ * (unless the slot has been reused 256 times since)
+ *
+ * LOCK is the policy protecting the object against interrupts (see CriticalSection.h)
+ */
+template <typename T, typename LOCK = NoLock, uint8_t SIZ = 20, typename COMPARE = std::less<T>>
+class ArrayPriorityQueue {
+
+    static_assert(SIZ < 255, "SIZ must be less than 255");
+
+public:
+
+    using Handle = uint16_t;
+    static constexpr Handle NO_HANDLE = 0xFFFF;
+
+protected:
+
+    using Guard = LockGuard<LOCK>;
+
+    T _data[SIZ];           // elements, indexed by handle (slot)
+    uint8_t _heap[SIZ];     // [0, _size) heap of slots, [_size, SIZ) free slots
+    uint8_t _pos[SIZ];      // slot -> index in _heap
+    uint8_t _gen[SIZ] = {}; // slot -> generation
+    uint8_t _size = 0;
+    uint8_t _fullPolicy = BLOCK;
+    COMPARE _compare;
+
+    /*
+     * following functions must be called inside a critical section
+     */
+
+    bool before(uint8_t i, uint8_t j) const {
+        return _compare(_data[_heap[i]], _data[_heap[j]]);
+    }
+
+    void swap(uint8_t i, uint8_t j) {
+        uint8_t slot = _heap[i];
+        _heap[i] = _heap[j];
+        _heap[j] = slot;
+        _pos[_heap[i]] = i;
+        _pos[_heap[j]] = j;
+    }
+
+    void siftUp(uint8_t i) {
+        while (i > 0) {
+            uint8_t parent = (i - 1) / 2;
+            if (! before(i, parent))
+                break;
+            swap(i, parent);
+            i = parent;
+        }
+    }
+
+    void siftDown(uint8_t i) {
+        for (;;) {
+            uint8_t first = i;
+            uint16_t left = 2 * i + 1;     // 16 bits: no wrap-around when SIZ >= 128
+            uint16_t right = left + 1;
+            if (left < _size && before(left, first))
+                first = left;
+            if (right < _size && before(right, first))
+                first = right;
+            if (first == i)
+                break;
+            swap(i, first);
+            i = first;
+        }
+    }
+
+    /*
+     * Removes element at heap index i, its slot becomes free
+     */
+    void removeAt(uint8_t i) {
+        uint8_t last = --_size;
+        _gen[_heap[i]]++;
+        if (i == last)
+            return;
+        swap(i, last);
+        if (i > 0 && before(i, (i - 1) / 2))
+            siftUp(i);
+        else
+            siftDown(i);
+    }
+
+    /*
+     * Heap index of the element which comes out last (one of the leaves)
+     */
+    uint8_t lastPos() const {
+        uint8_t res = _size / 2;
+        for (uint8_t i = res + 1; i < _size; i++) {
+            if (before(res, i))
+                res = i;
+        }
+        return res;
+    }
+
+    static uint8_t slot(Handle handle) {
+        return handle & 0xFF;
+    }
+
+    Handle handleOf(uint8_t slot) const {
+        return static_cast<Handle>((_gen[slot] << 8) | slot);
+    }
+
+    bool valid(Handle handle) const {
+        return slot(handle) < SIZ && _pos[slot(handle)] < _size && _gen[slot(handle)] == (handle >> 8);
+    }
+
+public:
+
+    /*
+     * fullPolicy is policy to apply when queue is full
+     * KEEP_FIRST = discard the element which comes out last, if the new one comes out before it
+     * BLOCK = no room available
+     */
+    enum { KEEP_FIRST, BLOCK };
+
+    ArrayPriorityQueue(uint8_t fullPolicy = BLOCK, COMPARE compare = COMPARE())
+        : _fullPolicy(fullPolicy), _compare(compare) {
+        for (uint8_t i = 0; i < SIZ; i++) {
+            _heap[i] = i;
+            _pos[i] = i;
+        }
+    }
+
+    constexpr uint8_t max_size() const {
+        return SIZ;
+    }
+
+    uint8_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return (_size == 0);
+    }
+
+    bool full() const {
+        return (_size == SIZ);
+    }
+
+    /*
+     * Inserts a copy of elt
+     * returns its handle, NO_HANDLE if no room available
+     */
+    Handle push(const T& elt) {
+        Guard guard;
+        if (_size == SIZ) {
+            if (_fullPolicy == BLOCK)
+                return NO_HANDLE;
+            uint8_t last = lastPos();
+            if (! _compare(elt, _data[_heap[last]]))
+                return NO_HANDLE;
+            removeAt(last);
+        }
+        uint8_t i = _size++;
+        uint8_t slot = _heap[i];
+        _data[slot] = elt;
+        siftUp(i);
+        return handleOf(slot);
+    }
+
+    const T& top() const {
+        Guard guard;
+        return _data[_heap[0]];
+    }
+
+    T* topPtr() {
+        Guard guard;
+        if (_size == 0)
+            return nullptr;
+        return & _data[_heap[0]];
+    }
+
+    Handle topHandle() const {
+        Guard guard;
+        return (_size == 0 ? NO_HANDLE : handleOf(_heap[0]));
+    }
+
+    void pop() {
+        Guard guard;
+        if (_size > 0)
+            removeAt(0);
+    }
+
+    /*
+     * Copies then removes top element in the same critical section
+     * returns false if empty
+     */
+    bool pop(T& elt) {
+        Guard guard;
+        if (_size == 0)
+            return false;
+        elt = _data[_heap[0]];
+        removeAt(0);
+        return true;
+    }
+
+    /*
+     * Element associated with handle, nullptr if popped or removed
+     */
+    T* get(Handle handle) {
+        Guard guard;
+        return (valid(handle) ? & _data[slot(handle)] : nullptr);
+    }
+
+    bool contains(Handle handle) const {
+        Guard guard;
+        return valid(handle);
+    }
+
+    /*
+     * Replaces the element associated with handle (decrease or increase key)
+     * returns false if handle is not in the queue
+     */
+    bool update(Handle handle, const T& elt) {
+        Guard guard;
+        if (! valid(handle))
+            return false;
+        _data[slot(handle)] = elt;
+        uint8_t i = _pos[slot(handle)];
+        if (i > 0 && before(i, (i - 1) / 2))
+            siftUp(i);
+        else
+            siftDown(i);
+        return true;
+    }
+
+    bool remove(Handle handle) {
+        Guard guard;
+        if (! valid(handle))
+            return false;
+        removeAt(_pos[slot(handle)]);
+        return true;
+    }
+
+    void clear() {
+        Guard guard;
+        for (uint8_t i = 0; i < _size; i++) {
+            _gen[_heap[i]]++;
+        }
+        _size = 0;
+    }
+
+};
+
+}
+}
@@ -0,0 +1,205 @@
+/*
+ * Module: BinaryLog
+ *
+ * Function: deferred binary logging (format id + raw arguments)
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+/*
+ * Format id: 32-bit FNV-1a hash of the format string, computed at compile time
+ *
+ * the format string itself is neither stored in flash nor sent,
+ * the host decoder rebuilds the id -> format table from the sources (see extras/binlog)
+ */
+constexpr uint32_t binaryLogId(const char* fmt) {
+	uint32_t hash = 2166136261u;
+	while (*fmt != 0) {
+		hash = (hash ^ static_cast<uint8_t>(*fmt++)) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * Size in bytes of the argument expected by the conversion specification starting at fmt (after '%')
+ * fmt is moved after the conversion character
+ *
+ * hh = 1 byte, h = 2 bytes, none / l / z / t = 4 bytes, ll / j = 8 bytes
+ * %c = 1 byte, %f %e %g %a = float (4 bytes), %lf %Lf... = double (8 bytes)
+ * returns -1 for unsupported conversions (%s, %p, %n, '*' width or precision)
+ */
+constexpr int binaryLogArgSize(const char*& fmt) {
+	while (*fmt == '-' || *fmt == '+' || *fmt == ' ' || *fmt == '#' || *fmt == '0') fmt++;
+	while ((*fmt >= '0' && *fmt <= '9') || *fmt == '.') fmt++;
+	if (*fmt == '*') return -1;
+	int size = 4;
+	bool isLong = false;
+	if (*fmt == 'h') {
+		fmt++;
+		size = 2;
+		if (*fmt == 'h') { fmt++; size = 1; }
+	} else if (*fmt == 'l' || *fmt == 'L') {
+		fmt++;
+		isLong = true;
+		if (*fmt == 'l') { fmt++; size = 8; }
+	} else if (*fmt == 'j') {
+		fmt++;
+		size = 8;
+	} else if (*fmt == 'z' || *fmt == 't') {
+		fmt++;
+	}
+	switch (*fmt++) {
+		case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+			return size;
+		case 'c':
+			return 1;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			return isLong ? 8 : 4;
+		default:
+			return -1;
+	}
+}
+
+/*
+ * Total size of the arguments expected by a format string, -1 if unsupported
+ */
+constexpr int binaryLogPayloadSize(const char* fmt) {
+	int total = 0;
+	while (*fmt != 0) {
+		if (*fmt++ != '%')
+			continue;
+		if (*fmt == '%') {
+			fmt++;
+			continue;
+		}
+		int size = binaryLogArgSize(fmt);
+		if (size < 0)
+			return -1;
+		total += size;
+	}
+	return total;
+}
+
+/*
+ * Signature of the arguments expected by a format string, checked at compile time by BinaryLog::record()
+ * bits 0-4: number of conversions, then 3 bits per conversion: log2(size), + 4 if floating point
+ * BINARY_LOG_UNSUPPORTED if a conversion is unsupported or if there are more than 19 conversions
+ */
+constexpr uint64_t BINARY_LOG_UNSUPPORTED = ~0ull;
+constexpr uint8_t BINARY_LOG_MAX_ARGS = 19;
+
+constexpr uint64_t binaryLogArgCode(size_t size, bool floating) {
+	return (size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3) | (floating ? 4 : 0);
+}
+
+constexpr uint64_t binaryLogSignature(const char* fmt) {
+	uint64_t signature = 0;
+	uint8_t count = 0;
+	while (*fmt != 0) {
+		if (*fmt++ != '%')
+			continue;
+		if (*fmt == '%') {
+			fmt++;
+			continue;
+		}
+		int size = binaryLogArgSize(fmt);
+		if (size < 0 || count == BINARY_LOG_MAX_ARGS)
+			return BINARY_LOG_UNSUPPORTED;
+		char conversion = fmt[-1];
+		bool floating = (conversion == 'f' || conversion == 'F' || conversion == 'e' || conversion == 'E'
+			|| conversion == 'g' || conversion == 'G' || conversion == 'a' || conversion == 'A');
+		signature |= binaryLogArgCode(size, floating) << (5 + 3 * count++);
+	}
+	return signature | count;
+}
+
+/*
+ * Same signature built from the argument types, one code per argument
+ */
+template <typename... Args>
+constexpr uint64_t binaryLogArgsSignature() {
+	uint64_t signature = 0;
+	uint8_t count = 0;
+	((signature |= binaryLogArgCode(sizeof(Args), std::is_floating_point<Args>::value) << (5 + 3 * count++)), ...);
+	return signature | count;
+}
+
+/*
+ * Writes log records into a byte sink (BufferedPrint, Serial, ...)
+ *
+ * Record layout (little endian):
+ * 	- format id (4 bytes)
+ * 	- payload length (1 byte)
+ * 	- raw bytes of each argument, in order
+ *
+ * A record is built on the stack and handed to the sink with a single write() call,
+ * which makes BINLOG usable inside ISR_callback() or ISR_timeout() with a BufferedPrint<..., PrimaskLock>
+ * configured with the DROP_NEWEST policy (a record is either fully stored or dropped)
+ */
+template <typename SINK>
+class BinaryLog {
+protected:
+
+	SINK &		_sink;
+	uint32_t	_dropped = 0;
+
+public:
+
+	static constexpr uint8_t HEADER_SIZE = 5;
+
+	BinaryLog(SINK & sink): _sink(sink) {}
+
+	/*
+	 * Use BINLOG macro instead, it computes id and checks arguments against the format at compile time
+	 */
+	template <uint64_t SIGNATURE, typename... Args>
+	bool record(uint32_t id, const Args... args) {
+		static_assert(((std::is_arithmetic<Args>::value || std::is_enum<Args>::value) && ...),
+			"binary log arguments must be numbers");
+		constexpr size_t len = (sizeof(Args) + ... + 0);
+		static_assert(len <= 255, "binary log record too long");
+		static_assert(SIGNATURE != BINARY_LOG_UNSUPPORTED, "unsupported conversion in binary log format (or more than 19)");
+		static_assert((SIGNATURE & 0x1F) == sizeof...(Args), "number of binary log arguments does not match format");
+		static_assert(SIGNATURE == binaryLogArgsSignature<Args...>(),
+			"binary log argument size or type does not match its conversion");
+
+		uint8_t buffer[HEADER_SIZE + len];
+		buffer[0] = id;
+		buffer[1] = id >> 8;
+		buffer[2] = id >> 16;
+		buffer[3] = id >> 24;
+		buffer[4] = len;
+		uint8_t* ptr = &buffer[HEADER_SIZE];
+		((memcpy(ptr, &args, sizeof(Args)), ptr += sizeof(Args)), ...);
+
+		if (_sink.write(buffer, sizeof buffer) != sizeof buffer) {
+			_dropped++;
+			return false;
+		}
+		return true;
+	}
+
+	/*
+	 * Number of records which have not been (fully) accepted by the sink
+	 */
+	uint32_t dropped() const {
+		return _dropped;
+	}
+};
+
+/*
+ * Logs a record. The format string must be a literal (printf syntax, no %s)
+ *
+ * 	BINLOG(binLog, "temp=%hd hum=%hhu", temperature, humidity);
+ */
+#define BINLOG(log, fmt, ...) \
+	(log).template record<binaryLogSignature(fmt)>(std::integral_constant<uint32_t, binaryLogId(fmt)>::value, ##__VA_ARGS__)
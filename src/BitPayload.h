@@ -0,0 +1,349 @@
+/*
+ * Module: BitPayload
+ *
+ * Function: bit-packed LoRa payload of quantized ranged values
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Field of a payload: value between min and max, quantized to resolution
+ * it needs the minimum number of bits to hold (max - min) / resolution
+ *
+ * 	constexpr PayloadField temperature { -40.0f, 85.0f, 0.1f };				// 11 bits
+ * 	constexpr PayloadField battery { Range<float>{ 3.0f, 4.2f }, 0.01f };	// 7 bits
+ */
+struct PayloadField {
+	float min;
+	float max;
+	float resolution;
+
+	constexpr PayloadField(float min, float max, float resolution)
+		: min(min), max(max), resolution(resolution) {}
+
+	/*
+	 * From a Range<T> (see Range.h)
+	 */
+	template <typename RANGE>
+	constexpr PayloadField(const RANGE & range, float resolution)
+		: min(range.min), max(range.max), resolution(resolution) {}
+
+	/*
+	 * Highest quantized value
+	 */
+	constexpr uint32_t steps() const {
+		return static_cast<uint32_t>((max - min) / resolution + 0.5f);
+	}
+
+	constexpr uint8_t bits() const {
+		uint8_t res = 0;
+		while (res < 32 && (steps() >> res) != 0) res++;
+		return res;
+	}
+
+	/*
+	 * Value clamped to [min, max] then rounded to the nearest step
+	 */
+	uint32_t quantize(float value) const {
+		if (value <= min) return 0;
+		if (value >= max) return steps();
+		return static_cast<uint32_t>((value - min) / resolution + 0.5f);
+	}
+
+	float dequantize(uint32_t step) const {
+		return min + step * resolution;
+	}
+};
+
+/*
+ * Compile-time layout of a payload: list of fields
+ *
+ * 	constexpr PayloadLayout layout { temperature, humidity, battery };
+ * 	uint8_t frame[layout.maxBytes(true)];
+ */
+template <size_t N>
+struct PayloadLayout {
+	PayloadField fields[N];
+
+	static constexpr size_t size() {
+		return N;
+	}
+
+	constexpr uint16_t bits() const {
+		uint16_t res = 0;
+		for (size_t i = 0; i < N; i++) res += fields[i].bits();
+		return res;
+	}
+
+	/*
+	 * Size of an absolute frame, delta frames are never larger
+	 * a frame starts with a mode bit when delta encoding is enabled
+	 */
+	constexpr uint8_t maxBytes(bool delta = false) const {
+		return (bits() + (delta ? 1 : 0) + 7) / 8;
+	}
+};
+
+template <typename... FIELDS>
+PayloadLayout(FIELDS...) -> PayloadLayout<sizeof...(FIELDS)>;
+
+/*
+ * Bit stream, least significant bits first
+ */
+class PayloadBitWriter {
+	uint8_t *	_buffer;
+	uint8_t		_capacity;
+	uint16_t	_pos = 0;
+
+public:
+
+	PayloadBitWriter(uint8_t * buffer, uint8_t capacity): _buffer(buffer), _capacity(capacity) {
+		memset(buffer, 0, capacity);
+	}
+
+	/*
+	 * returns false if the buffer is too small
+	 */
+	bool write(uint32_t value, uint8_t bits) {
+		if (_pos + bits > _capacity * 8u)
+			return false;
+		for (uint8_t i = 0; i < bits; ) {
+			uint8_t offset = _pos & 7;
+			uint8_t chunk = (8 - offset < bits - i ? 8 - offset : bits - i);
+			_buffer[_pos >> 3] |= ((value >> i) & ((1u << chunk) - 1)) << offset;
+			_pos += chunk;
+			i += chunk;
+		}
+		return true;
+	}
+
+	/*
+	 * Unsigned value in groups of 4 bits: 3 value bits + continuation bit
+	 */
+	bool writeVarint(uint32_t value) {
+		do {
+			uint8_t group = value & 7;
+			value >>= 3;
+			if (! write(group | (value != 0 ? 8 : 0), 4))
+				return false;
+		} while (value != 0);
+		return true;
+	}
+
+	uint8_t bytes() const {
+		return (_pos + 7) / 8;
+	}
+};
+
+class PayloadBitReader {
+	const uint8_t *	_buffer;
+	uint8_t			_size;
+	uint16_t		_pos = 0;
+
+public:
+
+	PayloadBitReader(const uint8_t * buffer, uint8_t size): _buffer(buffer), _size(size) {}
+
+	/*
+	 * returns false if the frame is too short
+	 */
+	bool read(uint32_t & value, uint8_t bits) {
+		if (_pos + bits > _size * 8u)
+			return false;
+		value = 0;
+		for (uint8_t i = 0; i < bits; ) {
+			uint8_t offset = _pos & 7;
+			uint8_t chunk = (8 - offset < bits - i ? 8 - offset : bits - i);
+			value |= static_cast<uint32_t>((_buffer[_pos >> 3] >> offset) & ((1u << chunk) - 1)) << i;
+			_pos += chunk;
+			i += chunk;
+		}
+		return true;
+	}
+
+	bool readVarint(uint32_t & value) {
+		value = 0;
+		for (uint8_t shift = 0; shift < 32; shift += 3) {
+			uint32_t group;
+			if (! read(group, 4))
+				return false;
+			value |= (group & 7) << shift;
+			if ((group & 8) == 0)
+				return true;
+		}
+		return false;
+	}
+};
+
+inline uint32_t zigzagEncode(int32_t value) {
+	return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t value) {
+	return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+/*
+ * Frame encoding shared by PayloadEncoder and PayloadDecoder (fields known at runtime)
+ *
+ * absolute frame:	[mode bit = 0] quantized fields on their minimum number of bits
+ * delta frame:		mode bit = 1, zigzag(step - previous step) of each field as 4 bits groups varint
+ * the mode bit is present only if delta encoding is enabled
+ *
+ * previous is nullptr for an absolute frame
+ * returns the frame size, 0 if the buffer is too small
+ */
+inline uint8_t payloadEncode(const PayloadField * fields, size_t count, const uint32_t * steps, bool delta,
+							 const uint32_t * previous, uint8_t * buffer, uint8_t capacity) {
+	PayloadBitWriter writer(buffer, capacity);
+	if (delta)
+		writer.write(previous != nullptr ? 1 : 0, 1);
+	for (size_t i = 0; i < count; i++) {
+		bool done = (previous != nullptr
+			? writer.writeVarint(zigzagEncode(static_cast<int32_t>(steps[i] - previous[i])))
+			: writer.write(steps[i], fields[i].bits()));
+		if (! done)
+			return 0;
+	}
+	return writer.bytes();
+}
+
+/*
+ * Decodes the quantized steps of a frame
+ * previous holds the steps of the last decoded frame (nullptr if delta encoding is disabled)
+ * returns false if the frame is truncated or is a delta frame without reference
+ */
+inline bool payloadDecode(const PayloadField * fields, size_t count, const uint8_t * buffer, uint8_t size,
+						  uint32_t * steps, const uint32_t * previous, bool hasPrevious) {
+	PayloadBitReader reader(buffer, size);
+	uint32_t mode = 0;
+	if (previous != nullptr && ! reader.read(mode, 1))
+		return false;
+	if (mode == 1) {
+		if (! hasPrevious)
+			return false;
+		for (size_t i = 0; i < count; i++) {
+			uint32_t zigzag;
+			if (! reader.readVarint(zigzag))
+				return false;
+			steps[i] = previous[i] + zigzagDecode(zigzag);
+			if (steps[i] > fields[i].steps())
+				return false;
+		}
+		return true;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (! reader.read(steps[i], fields[i].bits()))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Encoder of frames following a layout
+ *
+ * With delta encoding, a frame is encoded against the previous one unless it would be larger
+ * than an absolute frame,
+ * an absolute frame (keyframe) is sent at least every keyframeInterval frames
+ * so that the receiver recovers after a lost frame (0 = never forced, reset() forces next one)
+ *
+ * 	PayloadEncoder encoder(layout, true, 8);
+ * 	uint8_t len = encoder.encode(frame, temperature, humidity, battery);	// RangedValue or numbers
+ */
+template <size_t N>
+class PayloadEncoder {
+
+	const PayloadLayout<N> &	_layout;
+	uint32_t	_previous[N] = {};
+	bool		_delta;
+	bool		_hasPrevious = false;
+	uint8_t		_keyframeInterval;
+	uint8_t		_sinceKeyframe = 0;
+
+public:
+
+	PayloadEncoder(const PayloadLayout<N> & layout, bool delta = false, uint8_t keyframeInterval = 0)
+		: _layout(layout), _delta(delta), _keyframeInterval(keyframeInterval) {}
+
+	/*
+	 * Next frame is absolute
+	 */
+	void reset() {
+		_hasPrevious = false;
+	}
+
+	/*
+	 * values are converted to float (RangedValue<T> through its conversion to T)
+	 * buffer size must be at least layout.maxBytes(delta)
+	 * returns the frame size
+	 */
+	template <typename... VALUES>
+	uint8_t encode(uint8_t * buffer, const VALUES &... values) {
+		static_assert(sizeof...(VALUES) == N, "one value per field is expected");
+		const float input[N] = { static_cast<float>(values)... };
+		uint32_t steps[N];
+		for (size_t i = 0; i < N; i++) {
+			steps[i] = _layout.fields[i].quantize(input[i]);
+		}
+		uint8_t capacity = _layout.maxBytes(_delta);
+		bool keyframe = (_keyframeInterval != 0 && _sinceKeyframe + 1 >= _keyframeInterval);
+		uint8_t len = 0;
+		if (_delta && _hasPrevious && ! keyframe) {
+			// fails if the delta frame is larger than an absolute one
+			len = payloadEncode(_layout.fields, N, steps, true, _previous, buffer, capacity);
+		}
+		if (len == 0) {
+			len = payloadEncode(_layout.fields, N, steps, _delta, nullptr, buffer, capacity);
+			_sinceKeyframe = 0;
+		} else {
+			_sinceKeyframe++;
+		}
+		memcpy(_previous, steps, sizeof steps);
+		_hasPrevious = true;
+		return len;
+	}
+};
+
+/*
+ * Decoder of frames following a layout (device or host side)
+ */
+template <size_t N>
+class PayloadDecoder {
+
+	const PayloadLayout<N> &	_layout;
+	uint32_t	_previous[N] = {};
+	bool		_delta;
+	bool		_hasPrevious = false;
+
+public:
+
+	PayloadDecoder(const PayloadLayout<N> & layout, bool delta = false)
+		: _layout(layout), _delta(delta) {}
+
+	/*
+	 * To call after a lost frame: delta frames are rejected until next absolute frame
+	 */
+	void reset() {
+		_hasPrevious = false;
+	}
+
+	bool decode(const uint8_t * buffer, uint8_t size, float * values) {
+		uint32_t steps[N];
+		if (! payloadDecode(_layout.fields, N, buffer, size, steps, _delta ? _previous : nullptr, _hasPrevious))
+			return false;
+		for (size_t i = 0; i < N; i++) {
+			values[i] = _layout.fields[i].dequantize(steps[i]);
+		}
+		memcpy(_previous, steps, sizeof steps);
+		_hasPrevious = true;
+		return true;
+	}
+};
@@ -3,6 +3,7 @@
 #include <Arduino.h>
 #include <MemberFunction.h>
 #include <ArrayMap.h>
+#include <LatencyProbe.h>
 
 namespace lstl = leuville::simple_template_library;
 using namespace lstl;
@@ -22,7 +23,7 @@ class CallbackRegister
 	using MemberFuncPtr = void(V::*)();	// callback type (member function pointer)
 
     private:
-        ArrayMap<K, Callback<V>> _callbacks;
+        ArrayMap<K, Callback<V>, NoLock, SIZ> _callbacks;
 
     public:
 
@@ -30,8 +31,16 @@ class CallbackRegister
             _callbacks.put(key, Callback<V>(target, ptrF));        
         }
 
-        void execute(K key) {
-            _callbacks[key]();
+        /*
+         * Calls the function registered for key, if any
+         */
+        bool execute(K key) {
+            LATENCY_PROBE(PROBE_CALLBACK);
+            Callback<V>* callback = _callbacks.find(key);
+            if (callback == nullptr)
+                return false;
+            (*callback)();
+            return true;
         }
 
 };
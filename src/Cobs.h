@@ -0,0 +1,176 @@
+/*
+ * Module: Cobs
+ *
+ * Function: streaming COBS (Consistent Overhead Byte Stuffing) framing of binary data
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * A COBS frame contains no 0x00 byte and ends with a 0x00 delimiter:
+ * the receiver resynchronizes on the next delimiter after a lost byte
+ * overhead is 1 byte per 254 bytes + delimiter (hexadecimal text doubles the size)
+ *
+ * data is split into blocks: code byte n = n - 1 data bytes followed by an implied 0x00,
+ * 0xFF = 254 data bytes without implied 0x00 (the implied 0x00 of the last block is not part of the data)
+ */
+
+/*
+ * Part of the data of a frame (e.g. the two contiguous parts of a ring buffer)
+ */
+struct CobsSpan {
+	const uint8_t *	data;
+	size_t			len;
+};
+
+/*
+ * Maximum size of the encoding of len bytes, delimiter included
+ */
+constexpr size_t cobsEncodedMax(size_t len) {
+	return len + len / 254 + 2;
+}
+
+/*
+ * Encodes one frame made of count spans and writes it to sink (Print, Serial...)
+ *
+ * Zero-copy: source bytes are written by slices from the spans,
+ * each block costs one write() of its code byte and one write() per span it covers.
+ * Over a raw USB serial port, use a BufferedPrint sink so that small writes are coalesced
+ *
+ * returns the number of bytes written, delimiter included
+ */
+template <typename SINK>
+size_t cobsEncode(SINK & sink, const CobsSpan * spans, uint8_t count) {
+	static const uint8_t DELIMITER = 0;
+	size_t written = 0;
+	uint8_t span = 0;
+	size_t offset = 0;
+	auto skipEmpty = [&]() {
+		while (span < count && offset == spans[span].len) {
+			span++;
+			offset = 0;
+		}
+	};
+	skipEmpty();
+	for (;;) {
+		// non-zero run starting at (span, offset), up to 254 bytes
+		uint8_t run = 0;
+		uint8_t endSpan = span;
+		size_t endOffset = offset;
+		while (run < 254 && endSpan < count) {
+			if (endOffset == spans[endSpan].len) {
+				endSpan++;
+				endOffset = 0;
+				continue;
+			}
+			if (spans[endSpan].data[endOffset] == 0)
+				break;
+			run++;
+			endOffset++;
+		}
+		uint8_t code = run + 1;
+		written += sink.write(&code, 1);
+		// run bytes, one slice per span
+		while (span != endSpan || offset != endOffset) {
+			size_t end = (span == endSpan ? endOffset : spans[span].len);
+			if (end > offset)
+				written += sink.write(spans[span].data + offset, end - offset);
+			if (span == endSpan) {
+				offset = endOffset;
+			} else {
+				span++;
+				offset = 0;
+			}
+		}
+		skipEmpty();
+		if (span == count)
+			break;
+		if (run < 254) {
+			// zero byte replaced by the code of the next block
+			offset++;
+			skipEmpty();
+		}
+	}
+	written += sink.write(&DELIMITER, 1);
+	return written;
+}
+
+template <typename SINK>
+size_t cobsEncode(SINK & sink, const uint8_t * data, size_t len) {
+	CobsSpan span { data, len };
+	return cobsEncode(sink, &span, 1);
+}
+
+/*
+ * Streaming decoder: bytes are given as they are received, decoded frames are stored into buffer
+ *
+ * 	if (decoder.put(byte) >= 0) use(decoder.data(), decoder.size());
+ */
+class CobsDecoder {
+	uint8_t *	_buffer;
+	size_t		_capacity;
+	size_t		_size = 0;			// frame being decoded
+	size_t		_frameSize = 0;		// last decoded frame
+	uint8_t		_remaining = 0;		// data bytes left in current block
+	bool		_pendingZero = false;	// implied zero of previous block
+	bool		_started = false;
+	bool		_overflow = false;
+
+	void append(uint8_t byte) {
+		if (_size < _capacity)
+			_buffer[_size++] = byte;
+		else
+			_overflow = true;
+	}
+
+public:
+
+	CobsDecoder(uint8_t * buffer, size_t capacity): _buffer(buffer), _capacity(capacity) {}
+
+	/*
+	 * returns the frame size when byte completes a valid frame,
+	 * -1 otherwise (frame in progress, or invalid frame which is discarded)
+	 */
+	int32_t put(uint8_t byte) {
+		if (byte == 0) {
+			bool valid = _started && _remaining == 0 && ! _overflow;
+			int32_t res = (valid ? static_cast<int32_t>(_size) : -1);
+			_frameSize = (valid ? _size : 0);
+			_size = 0;
+			_remaining = 0;
+			_pendingZero = false;
+			_started = false;
+			_overflow = false;
+			return res;
+		}
+		if (_remaining == 0) {
+			if (_pendingZero)
+				append(0);
+			_remaining = byte - 1;
+			_pendingZero = (byte != 0xFF);
+			_started = true;
+		} else {
+			append(byte);
+			_remaining--;
+		}
+		return -1;
+	}
+
+	/*
+	 * Last decoded frame, valid until the next byte is given
+	 */
+	const uint8_t * data() const {
+		return _buffer;
+	}
+
+	size_t size() const {
+		return _frameSize;
+	}
+};
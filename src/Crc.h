@@ -0,0 +1,192 @@
+/*
+ * Module: Crc
+ *
+ * Function: table-driven CRC (CRC-8, CRC-16/CCITT, CRC-32) with incremental update
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Computation methods, from smallest to fastest
+ * CRC_BITWISE	= 8 iterations per byte, no table
+ * CRC_NIBBLE	= two lookups per byte in a 16 entries table (flash-constrained builds)
+ * CRC_TABLE	= one lookup per byte in a 256 entries table
+ * CRC_SLICE4	= 4 bytes per iteration with 4 tables of 256 entries (32-bit MCU)
+ */
+enum CrcMethod : uint8_t { CRC_BITWISE, CRC_NIBBLE, CRC_TABLE, CRC_SLICE4 };
+
+/*
+ * Tables generated at compile time (constexpr, stored in flash), only instantiated when used
+ *
+ * POLY is given in normal (MSB-first) form, REFLECTED algorithms work on the reversed polynomial
+ */
+template <typename T, uint8_t WIDTH, T POLY, bool REFLECTED>
+struct CrcTables {
+
+	static constexpr T MASK = (WIDTH == 8 * sizeof(T) ? static_cast<T>(~T(0)) : static_cast<T>((T(1) << WIDTH) - 1));
+
+	static constexpr T reflect(T value, uint8_t bits) {
+		T res = 0;
+		for (uint8_t i = 0; i < bits; i++) {
+			res = static_cast<T>((res << 1) | ((value >> i) & 1));
+		}
+		return res;
+	}
+
+	static constexpr T POLY_REFLECTED = reflect(POLY, WIDTH);
+
+	/*
+	 * Register after processing bits bits of value (value aligned on the register input side)
+	 */
+	static constexpr T shift(T crc, uint8_t bits) {
+		for (uint8_t i = 0; i < bits; i++) {
+			if (REFLECTED)
+				crc = static_cast<T>((crc & 1) ? (crc >> 1) ^ POLY_REFLECTED : (crc >> 1));
+			else
+				crc = static_cast<T>(((crc >> (WIDTH - 1)) & 1) ? ((crc << 1) ^ POLY) & MASK : (crc << 1) & MASK);
+		}
+		return crc;
+	}
+
+	/*
+	 * entry i = register after processing byte / nibble i from a zero register
+	 */
+	static constexpr T entry(uint8_t i, uint8_t bits) {
+		return shift(REFLECTED ? static_cast<T>(i) : static_cast<T>(static_cast<T>(i) << (WIDTH - bits)), bits);
+	}
+
+	template <uint16_t SIZE, uint8_t COUNT>
+	struct Table {
+		T values[COUNT][SIZE] {};
+
+		constexpr Table(): values() {
+			uint8_t bits = (SIZE == 16 ? 4 : 8);
+			for (uint16_t i = 0; i < SIZE; i++) {
+				values[0][i] = entry(static_cast<uint8_t>(i), bits);
+			}
+			// values[k][i]: byte i followed by k zero bytes
+			for (uint8_t k = 1; k < COUNT; k++) {
+				for (uint16_t i = 0; i < SIZE; i++) {
+					T prev = values[k - 1][i];
+					values[k][i] = (REFLECTED
+						? static_cast<T>((prev >> 8) ^ values[0][prev & 0xFF])
+						: static_cast<T>(((prev << 8) & MASK) ^ values[0][(prev >> (WIDTH - 8)) & 0xFF]));
+				}
+			}
+		}
+	};
+
+	static constexpr Table<16, 1> NIBBLE {};
+	static constexpr Table<256, 1> BYTE {};
+	static constexpr Table<256, 4> SLICE4 {};
+};
+
+/*
+ * CRC of any width from 8 to 32 bits
+ *
+ * 	Crc32<> crc;
+ * 	crc.update(header, sizeof header);
+ * 	crc.update(payload, len);			// streaming
+ * 	uint32_t value = crc.value();
+ *
+ * 	uint16_t value = Crc16Ccitt<CRC_NIBBLE>::compute(frame, len);
+ */
+template <typename T, uint8_t WIDTH, T POLY, T INIT, bool REFLECTED, T XOROUT, uint8_t METHOD = CRC_TABLE>
+class Crc {
+
+	static_assert(WIDTH >= 8 && WIDTH <= 32 && WIDTH <= 8 * sizeof(T), "WIDTH must be between 8 and 32 bits");
+
+	using Tables = CrcTables<T, WIDTH, POLY, REFLECTED>;
+
+	static constexpr T INIT_REGISTER = (REFLECTED ? Tables::reflect(INIT, WIDTH) : INIT);
+
+	T _crc = INIT_REGISTER;
+
+	static T updateByte(T crc, uint8_t byte) {
+		if constexpr (METHOD == CRC_BITWISE) {
+			return Tables::shift(static_cast<T>(crc ^ (REFLECTED ? byte : static_cast<T>(byte) << (WIDTH - 8))), 8);
+		} else if constexpr (METHOD == CRC_NIBBLE) {
+			const T * table = Tables::NIBBLE.values[0];
+			if constexpr (REFLECTED) {
+				crc = static_cast<T>((crc >> 4) ^ table[(crc ^ byte) & 0x0F]);
+				return static_cast<T>((crc >> 4) ^ table[(crc ^ (byte >> 4)) & 0x0F]);
+			} else {
+				crc = static_cast<T>(((crc << 4) & Tables::MASK) ^ table[((crc >> (WIDTH - 4)) ^ (byte >> 4)) & 0x0F]);
+				return static_cast<T>(((crc << 4) & Tables::MASK) ^ table[((crc >> (WIDTH - 4)) ^ byte) & 0x0F]);
+			}
+		} else {
+			const T * table = Tables::BYTE.values[0];
+			if constexpr (REFLECTED)
+				return static_cast<T>((crc >> 8) ^ table[(crc ^ byte) & 0xFF]);
+			else
+				return static_cast<T>(((crc << 8) & Tables::MASK) ^ table[((crc >> (WIDTH - 8)) ^ byte) & 0xFF]);
+		}
+	}
+
+public:
+
+	using value_type = T;
+
+	void reset() {
+		_crc = INIT_REGISTER;
+	}
+
+	/*
+	 * Adds data to the CRC, may be called several times
+	 */
+	Crc & update(const void * data, size_t len) {
+		const uint8_t * bytes = static_cast<const uint8_t*>(data);
+		T crc = _crc;
+		if constexpr (METHOD == CRC_SLICE4) {
+			// words are built from bytes: no unaligned access on Cortex-M0
+			const auto & table = Tables::SLICE4.values;
+			for (; len >= 4; len -= 4, bytes += 4) {
+				uint32_t x;
+				if constexpr (REFLECTED) {
+					x = crc ^ (bytes[0] | (bytes[1] << 8) | (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24));
+					crc = static_cast<T>(table[3][x & 0xFF] ^ table[2][(x >> 8) & 0xFF] ^ table[1][(x >> 16) & 0xFF] ^ table[0][x >> 24]);
+				} else {
+					x = (static_cast<uint32_t>(crc) << (32 - WIDTH))
+						^ ((static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (bytes[2] << 8) | bytes[3]);
+					crc = static_cast<T>(table[3][x >> 24] ^ table[2][(x >> 16) & 0xFF] ^ table[1][(x >> 8) & 0xFF] ^ table[0][x & 0xFF]);
+				}
+			}
+		}
+		while (len--) {
+			crc = updateByte(crc, *bytes++);
+		}
+		_crc = crc;
+		return *this;
+	}
+
+	/*
+	 * CRC of data added since last reset (data may still be added)
+	 */
+	T value() const {
+		return static_cast<T>((_crc ^ XOROUT) & Tables::MASK);
+	}
+
+	static T compute(const void * data, size_t len) {
+		Crc crc;
+		return crc.update(data, len).value();
+	}
+};
+
+/*
+ * Usual CRCs (check value of "123456789" between parentheses)
+ */
+template <uint8_t METHOD = CRC_TABLE>
+using Crc8 = Crc<uint8_t, 8, 0x07, 0x00, false, 0x00, METHOD>;						// CRC-8/SMBUS (0xF4)
+
+template <uint8_t METHOD = CRC_TABLE>
+using Crc16Ccitt = Crc<uint16_t, 16, 0x1021, 0xFFFF, false, 0x0000, METHOD>;		// CRC-16/CCITT-FALSE (0x29B1)
+
+template <uint8_t METHOD = CRC_TABLE>
+using Crc32 = Crc<uint32_t, 32, 0x04C11DB7, 0xFFFFFFFF, true, 0xFFFFFFFF, METHOD>;	// CRC-32/ISO-HDLC (0xCBF43926)
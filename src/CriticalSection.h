@@ -0,0 +1,170 @@
+/*
+ * Module: CriticalSection
+ *
+ * Function: lock policies protecting data shared with interrupts
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <type_traits>
+
+namespace leuville {
+namespace simple_template_library {
+
+/*
+ * A lock policy provides:
+ * 	- State: type of the saved interrupt state
+ * 	- static State lock(): masks interrupts, returns previous state
+ * 	- static void unlock(State): restores the previous state
+ *
+ * Saving and restoring the state makes policies nesting-safe: a lock taken
+ * inside another critical section (or in an ISR) does not re-enable interrupts too early
+ */
+
+/*
+ * No protection: object not shared with interrupts
+ */
+struct NoLock {
+	using State = uint8_t;
+	static State lock() { return 0; }
+	static void unlock(State) {}
+};
+
+/*
+ * Masks all interrupts (PRIMASK save/restore)
+ */
+struct PrimaskLock {
+	using State = uint32_t;
+
+	static State lock() {
+		State state = __get_PRIMASK();
+		__disable_irq();
+		return state;
+	}
+
+	static void unlock(State state) {
+		__set_PRIMASK(state);
+	}
+};
+
+/*
+ * Masks interrupts whose priority is PRIORITY or lower (numerically >= PRIORITY)
+ * higher priority interrupts stay live. PRIORITY must be at least 1.
+ *
+ * BASEPRI is only available on Cortex-M3 and above: on Cortex-M0+ (SAMD21) this is a PrimaskLock
+ */
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3)
+template <uint8_t PRIORITY>
+struct BasepriLock {
+	static_assert(PRIORITY >= 1, "BasepriLock: PRIORITY 0 writes BASEPRI = 0, which masks nothing");
+	static_assert(PRIORITY < (1 << __NVIC_PRIO_BITS), "BasepriLock: PRIORITY out of the NVIC priority range");
+
+	using State = uint32_t;
+
+	static State lock() {
+		State state = __get_BASEPRI();
+		__set_BASEPRI_MAX(PRIORITY << (8 - __NVIC_PRIO_BITS));
+		return state;
+	}
+
+	static void unlock(State state) {
+		__set_BASEPRI(state);
+	}
+};
+#else
+template <uint8_t PRIORITY>
+struct BasepriLock: PrimaskLock {
+	static_assert(PRIORITY >= 1, "BasepriLock: PRIORITY 0 writes BASEPRI = 0, which masks nothing");
+};
+#endif
+
+/*
+ * Former "bool SYNC" template parameter
+ */
+template <bool SYNC>
+using SyncLock = typename std::conditional<SYNC, PrimaskLock, NoLock>::type;
+
+/*
+ * Lock statistics of InstrumentedLock
+ */
+struct LockStats {
+	uint32_t	count = 0;		// outermost lock acquisitions
+	uint32_t	maxHold = 0;	// us
+	uint64_t	totalHold = 0;	// us
+};
+
+/*
+ * Wraps a lock policy and measures how long interrupts are masked (micros())
+ * Only outermost critical sections are accounted
+ *
+ * Intended for tests and tuning (host mock with NoLock, or on target)
+ */
+template <typename LOCK = NoLock>
+struct InstrumentedLock {
+	struct State {
+		typename LOCK::State	state;
+		unsigned long			start;
+	};
+
+	static inline LockStats		stats;
+	static inline uint8_t		depth = 0;
+
+	static State lock() {
+		typename LOCK::State state = LOCK::lock();
+		return { state, (depth++ == 0 ? micros() : 0) };
+	}
+
+	static void unlock(State state) {
+		if (--depth == 0) {
+			uint32_t hold = micros() - state.start;
+			stats.count++;
+			stats.totalHold += hold;
+			if (hold > stats.maxHold) stats.maxHold = hold;
+		}
+		LOCK::unlock(state.state);
+	}
+};
+
+/*
+ * Scoped critical section
+ */
+template <typename LOCK>
+class LockGuard {
+	typename LOCK::State _state;
+public:
+	LockGuard(): _state(LOCK::lock()) {}
+	~LockGuard() { LOCK::unlock(_state); }
+	LockGuard(const LockGuard &) = delete;
+	LockGuard & operator=(const LockGuard &) = delete;
+};
+
+/*
+ * Atomic compare-and-swap of a word shared with interrupts of any priority
+ * if word == expected, stores desired and returns true
+ * otherwise copies word into expected and returns false
+ *
+ * LDREX/STREX on Cortex-M3 and above (or host atomics)
+ * a few instructions long PRIMASK critical section on Cortex-M0+ which has no exclusive access
+ */
+template <typename W>
+inline bool compareExchange(volatile W & word, W & expected, W desired) {
+#if defined(__ARM_ARCH_6M__)
+	LockGuard<PrimaskLock> guard;
+	if (word != expected) {
+		expected = word;
+		return false;
+	}
+	word = desired;
+	return true;
+#else
+	return __atomic_compare_exchange_n(&word, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+}
+}
@@ -0,0 +1,157 @@
+/*
+ * Module: DutyCyclePolicy
+ *
+ * Function: battery-adaptive timer period
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <initializer_list>
+#include <Range.h>
+
+/*
+ * Timer period to apply from a given battery level (percent)
+ */
+struct DutyCycleTier {
+	uint8_t		level;
+	uint32_t	timeout;	// seconds
+};
+
+/*
+ * Links battery level to ISRTimer period
+ *
+ * update() is called from the main loop with a fresh battery level (ADC read)
+ * timeout() only returns the cached period, hence may be returned by ISR_timeout()
+ *
+ * STEP mode: the timeout of the first tier whose level is less or equal to the battery level
+ * LINEAR mode: linear interpolation of timeouts between tiers
+ *
+ * STEP mode hysteresis: the current tier is kept until the battery level crosses one of its
+ * boundaries by hysteresis, hence a level oscillating around a boundary does not flip the period
+ * LINEAR mode hysteresis: a battery level variation smaller than hysteresis is ignored
+ *
+ * 	DutyCyclePolicy<> policy({ {50, 15*60}, {20, 60*60}, {0, 6*60*60} });
+ *
+ * 	loop:			policy.update(getBatteryPower<uint8_t>(0, 100));
+ * 	ISR_timeout:	return policy.timeout();
+ */
+template <uint8_t SIZ = 4>
+class DutyCyclePolicy {
+protected:
+
+	DutyCycleTier		_tiers[SIZ];	// sorted by decreasing level
+	uint8_t				_size = 0;
+	uint8_t				_mode = STEP;
+	uint8_t				_hysteresis = 5;
+	uint8_t				_level = NO_LEVEL;	// battery level used for last computation
+	uint8_t				_tier = 0;			// current tier (STEP mode)
+	volatile uint32_t	_timeout = 0;
+
+	/*
+	 * Index of the first tier whose level is less or equal to level, last tier if none
+	 */
+	uint8_t tierOf(uint8_t level) const {
+		for (uint8_t i = 0; i < _size; i++) {
+			if (level >= _tiers[i].level)
+				return i;
+		}
+		return (_size > 0 ? _size - 1 : 0);
+	}
+
+	/*
+	 * true if level is far enough from the current tier (STEP) or from the last level (LINEAR)
+	 */
+	bool outside(uint8_t level) const {
+		if (_level == NO_LEVEL)
+			return true;
+		if (_mode == STEP) {
+			bool down = (_tier + 1 < _size) && (level + _hysteresis < _tiers[_tier].level);
+			bool up = (_tier > 0) && (level >= _tiers[_tier-1].level + _hysteresis);
+			return down || up;
+		}
+		uint8_t delta = (level > _level ? level - _level : _level - level);
+		return delta >= _hysteresis;
+	}
+
+	uint32_t computeTimeout(uint8_t level) const {
+		if (_size == 0)
+			return 0;
+		if (level >= _tiers[0].level)
+			return _tiers[0].timeout;
+		for (uint8_t i = 1; i < _size; i++) {
+			const DutyCycleTier & upper = _tiers[i-1];
+			const DutyCycleTier & lower = _tiers[i];
+			if (level < lower.level)
+				continue;
+			if (_mode == STEP)
+				return lower.timeout;
+			// linear interpolation in integer arithmetic (no soft float in ISR context)
+			int64_t span = static_cast<int64_t>(upper.timeout) - lower.timeout;
+			return lower.timeout + span * (level - lower.level) / (upper.level - lower.level);
+		}
+		return _tiers[_size-1].timeout;
+	}
+
+public:
+
+	enum { STEP, LINEAR };
+
+	static constexpr uint8_t NO_LEVEL = 0xFF;	// no update() yet, levels are 0..100
+
+	DutyCyclePolicy(std::initializer_list<DutyCycleTier> tiers, uint8_t mode = STEP, uint8_t hysteresis = 5)
+		: _mode(mode), _hysteresis(hysteresis) {
+		for (auto & tier: tiers) {
+			if (_size == SIZ)
+				break;
+			// insertion sort by decreasing level
+			uint8_t pos = _size++;
+			while (pos > 0 && _tiers[pos-1].level < tier.level) {
+				_tiers[pos] = _tiers[pos-1];
+				pos--;
+			}
+			_tiers[pos] = tier;
+		}
+		_tier = tierOf(100);
+		_timeout = computeTimeout(100);		// full battery until the first update()
+	}
+
+	/*
+	 * New battery level (percent), the first one is always taken into account
+	 * returns true if the timeout has been modified
+	 */
+	bool update(uint8_t level) {
+		if (! outside(level))
+			return false;
+		_level = level;
+		_tier = tierOf(level);
+		uint32_t timeout = computeTimeout(level);
+		if (timeout == _timeout)
+			return false;
+		_timeout = timeout;
+		return true;
+	}
+
+	template <typename T>
+	bool update(const RangedValue<T> & level) {
+		return update(scaleValue(level, Range<uint8_t>{0, 100}));
+	}
+
+	/*
+	 * Cached timer period (seconds), ISR safe
+	 */
+	uint32_t timeout() const {
+		return _timeout;
+	}
+
+	/*
+	 * Battery level used for last computation, NO_LEVEL before the first update()
+	 */
+	uint8_t level() const {
+		return _level;
+	}
+};
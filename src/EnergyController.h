@@ -15,6 +15,8 @@
 #include <initializer_list>
 #include <functional>
 #include <Range.h>
+#include <LowPowerClock.h>
+#include <FastGpio.h>
 
 /*
  * VMIN : min voltage in millivolts
@@ -27,6 +29,27 @@ protected:
 
 	std::function<double(void)> _getVoltage = []() -> double { return VMAX; };
 
+	uint32_t	_activeCurrent = 10000;		// microamps
+	uint32_t	_standbyCurrent = 20;		// microamps
+	uint64_t	_charge = 0;				// microamps x milliseconds
+	uint64_t	_accountedActiveMs = 0;
+	uint64_t	_accountedStandbyMs = 0;
+
+	/*
+	 * Integrates the current drawn since last update, from LowPowerClock power statistics
+	 */
+	void updateCharge() {
+		LowPowerClock::PowerStats stats = lowPowerClock.getPowerStats();
+		if (stats.activeMs < _accountedActiveMs || stats.standbyMs < _accountedStandbyMs) {
+			// power statistics have been reset
+			_accountedActiveMs = _accountedStandbyMs = 0;
+		}
+		_charge += (stats.activeMs - _accountedActiveMs) * _activeCurrent;
+		_charge += (stats.standbyMs - _accountedStandbyMs) * _standbyCurrent;
+		_accountedActiveMs = stats.activeMs;
+		_accountedStandbyMs = stats.standbyMs;
+	}
+
 	/*
 	 * Function to get current voltage (millivolts) from board 
 	 *
@@ -80,13 +103,42 @@ public:
 		return isBelowPercent(power, percent, min, max);
 	}
 
+	/*
+	 * Current drawn by the board in active and standby modes (microamps)
+	 * used to estimate the consumed charge, see getConsumedCharge()
+	 */
+	void setCurrents(uint32_t activeMicroAmps, uint32_t standbyMicroAmps) {
+		updateCharge();
+		_activeCurrent = activeMicroAmps;
+		_standbyCurrent = standbyMicroAmps;
+	}
+
+	/*
+	 * Estimated charge consumed (mAh) since startup or since resetConsumedCharge()
+	 */
+	double getConsumedCharge() {
+		updateCharge();
+		return _charge / 3.6e9;
+	}
+
+	void resetConsumedCharge() {
+		updateCharge();
+		_charge = 0;
+	}
+
+	/*
+	 * Time spent in active and standby modes, wake-up reasons
+	 */
+	LowPowerClock::PowerStats getPowerStats() const {
+		return lowPowerClock.getPowerStats();
+	}
+
 	/* 
 	 * pullup unused pins to save energy and avoid unwanted interrupts
+	 * pins are grouped by port and configured with a few register writes
 	 */
 	void setUnusedPins(std::initializer_list<uint8_t> unusedPins) {
-		for(auto pin: unusedPins) {
-			setUnusedPin(pin);
-		}
+		PortMasks(unusedPins).setUnused();
 	}
 
 	void setUnusedPin(uint8_t unusedPin) {
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+#include <type_traits>
+#include <ArrayDeque.h>
+#include <LatencyProbe.h>
+
+namespace leuville {
+namespace simple_template_library {
+
+/*
+ * Event identifier typed by its payload (void = no payload)
+ *
+ * 	struct BatteryLow { uint16_t millivolts; };
+ * 	constexpr EventTopic<BatteryLow> BATTERY_LOW { 2 };
+ */
+template <typename T>
+struct EventTopic {
+	uint8_t id;
+};
+
+/*
+ * Subscriber: topic + handler called with its target and a pointer to the payload
+ * may be built at compile time with eventSubscriber()
+ */
+struct EventSubscriber {
+	uint8_t	topic;
+	void	(*handler)(void * target, const void * payload);
+	void *	target;
+};
+
+/*
+ * Adapters from free functions / member functions to EventSubscriber::handler
+ */
+template <auto HANDLER>
+struct EventHandler;
+
+template <typename T, void (*F)(const T &)>
+struct EventHandler<F> {
+	using Payload = T;
+	using Target = void;
+	static void call(void *, const void * payload) { F(*static_cast<const T*>(payload)); }
+};
+
+template <void (*F)()>
+struct EventHandler<F> {
+	using Payload = void;
+	using Target = void;
+	static void call(void *, const void *) { F(); }
+};
+
+template <typename V, typename T, void (V::*M)(const T &)>
+struct EventHandler<M> {
+	using Payload = T;
+	using Target = V;
+	static void call(void * target, const void * payload) { (static_cast<V*>(target)->*M)(*static_cast<const T*>(payload)); }
+};
+
+template <typename V, void (V::*M)()>
+struct EventHandler<M> {
+	using Payload = void;
+	using Target = V;
+	static void call(void * target, const void *) { (static_cast<V*>(target)->*M)(); }
+};
+
+/*
+ * 	void onBatteryLow(const BatteryLow & event);
+ * 	constexpr EventSubscriber subscribers[] = {
+ * 		eventSubscriber<onBatteryLow>(BATTERY_LOW),
+ * 		eventSubscriber<&Device::onButton>(BUTTON, &device),
+ * 	};
+ */
+template <auto HANDLER, typename T>
+constexpr EventSubscriber eventSubscriber(EventTopic<T> topic, typename EventHandler<HANDLER>::Target * target = nullptr) {
+	static_assert(std::is_same<T, typename EventHandler<HANDLER>::Payload>::value, "handler does not match topic payload");
+	return { topic.id, &EventHandler<HANDLER>::call, target };
+}
+
+/*
+ * Publish / subscribe bus
+ *
+ * post() copies the event into a ring (ArrayDeque), it is O(1) and may be called from an ISR
+ * dispatch() is called from the loop: it pops queued events and calls every subscriber of their topic
+ *
+ * Subscribers come from a static table (flash) and/or are registered at init by subscribe()
+ * PAYLOAD is the maximum payload size, payloads are trivially copyable (no heap)
+ *
+ * LOCK is the policy protecting the ring against interrupts (see CriticalSection.h)
+ */
+template <uint8_t PAYLOAD = 8, uint8_t QUEUE = 16, uint8_t SUBSCRIBERS = 8, typename LOCK = PrimaskLock>
+class EventBus {
+
+protected:
+
+	struct Event {
+		alignas(4) uint8_t	payload[PAYLOAD > 0 ? PAYLOAD : 1];
+		uint8_t				topic;
+	};
+
+	ArrayDeque<Event, LOCK, QUEUE>	_queue;
+	const EventSubscriber *	_table;
+	uint8_t					_tableSize;
+	EventSubscriber			_subscribers[SUBSCRIBERS];
+	uint8_t					_size = 0;
+	volatile uint32_t		_dropped = 0;
+
+	bool enqueue(uint8_t topic, const void * payload, uint8_t size) {
+		Event event;
+		event.topic = topic;
+		if (size > 0) memcpy(event.payload, payload, size);
+		if (_queue.push_back(event))
+			return true;
+		LockGuard<LOCK> guard;
+		_dropped = _dropped + 1;
+		return false;
+	}
+
+	void fanOut(const Event & event) {
+		for (uint8_t i = 0; i < _tableSize; i++) {
+			if (_table[i].topic == event.topic)
+				_table[i].handler(_table[i].target, event.payload);
+		}
+		for (uint8_t i = 0; i < _size; i++) {
+			if (_subscribers[i].topic == event.topic)
+				_subscribers[i].handler(_subscribers[i].target, event.payload);
+		}
+	}
+
+public:
+
+	EventBus(): _table(nullptr), _tableSize(0) {}
+
+	/*
+	 * table: static subscribers, must outlive the bus (e.g. constexpr global array)
+	 */
+	template <size_t N>
+	EventBus(const EventSubscriber (&table)[N]): _table(table), _tableSize(N) {}
+
+	/*
+	 * Registers a subscriber (at init, not from an ISR)
+	 * returns false if the table is full
+	 */
+	bool subscribe(const EventSubscriber & subscriber) {
+		if (_size == SUBSCRIBERS)
+			return false;
+		_subscribers[_size++] = subscriber;
+		return true;
+	}
+
+	template <auto HANDLER, typename T>
+	bool subscribe(EventTopic<T> topic, typename EventHandler<HANDLER>::Target * target = nullptr) {
+		return subscribe(eventSubscriber<HANDLER>(topic, target));
+	}
+
+	/*
+	 * Queues an event, from ISR or loop
+	 * returns false if the ring is full (event dropped)
+	 */
+	template <typename T>
+	bool post(EventTopic<T> topic, const T & payload) {
+		static_assert(std::is_trivially_copyable<T>::value, "payload must be trivially copyable");
+		static_assert(sizeof(T) <= PAYLOAD, "payload larger than PAYLOAD");
+		static_assert(alignof(T) <= 4, "payload alignment larger than 4");
+		return enqueue(topic.id, &payload, sizeof(T));
+	}
+
+	bool post(EventTopic<void> topic) {
+		return enqueue(topic.id, nullptr, 0);
+	}
+
+	/*
+	 * Delivers at most max queued events to their subscribers
+	 * returns the number of events delivered
+	 */
+	uint8_t dispatch(uint8_t max = QUEUE) {
+		uint8_t count = 0;
+		Event event;
+		while (count < max && _queue.pop_front(event)) {
+			LATENCY_PROBE(PROBE_CALLBACK);
+			fanOut(event);
+			count++;
+		}
+		return count;
+	}
+
+	uint8_t pending() const {
+		return _queue.size();
+	}
+
+	/*
+	 * Number of events lost because the ring was full
+	 */
+	uint32_t dropped() const {
+		return _dropped;
+	}
+};
+
+}
+}
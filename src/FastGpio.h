@@ -0,0 +1,228 @@
+/*
+ * Module: FastGpio
+ *
+ * Function: GPIO access with direct port register writes
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <initializer_list>
+
+/*
+ * digitalWrite() looks up g_APinDescription then does a read-modify-write of the port on each call
+ * Here the port group and mask are resolved once (at compile time for FastPin)
+ * and each access is a single store into OUTSET / OUTCLR / OUTTGL / DIRSET
+ *
+ * Other architectures fall back to the Arduino API, with optional write / toggle counters per pin
+ * (GPIO_TRAFFIC_PINS, defined by the host Arduino.h of extras) to check GPIO traffic from host code
+ */
+#if defined(ARDUINO_ARCH_SAMD)
+
+#ifndef PORT_GROUPS
+#define PORT_GROUPS 2
+#endif
+
+/*
+ * Pin known at compile time by its port group and bit number
+ * e.g. builtin led of Feather M0 (PA17): FastPin<PORTA, 17>
+ */
+template <uint8_t GROUP, uint8_t BIT>
+struct FastPin {
+	static constexpr uint32_t MASK = 1ul << BIT;
+
+	static void output() {
+		PORT->Group[GROUP].PINCFG[BIT].reg = PORT_PINCFG_INEN;
+		PORT->Group[GROUP].DIRSET.reg = MASK;
+	}
+
+	static void input(bool pullup = false) {
+		PORT->Group[GROUP].DIRCLR.reg = MASK;
+		PORT->Group[GROUP].PINCFG[BIT].reg = PORT_PINCFG_INEN | (pullup ? PORT_PINCFG_PULLEN : 0);
+		if (pullup) PORT->Group[GROUP].OUTSET.reg = MASK;
+	}
+
+	static void high() { PORT->Group[GROUP].OUTSET.reg = MASK; }
+	static void low() { PORT->Group[GROUP].OUTCLR.reg = MASK; }
+	static void toggle() { PORT->Group[GROUP].OUTTGL.reg = MASK; }
+	static void write(bool value) { if (value) high(); else low(); }
+	static bool read() { return (PORT->Group[GROUP].IN.reg & MASK) != 0; }
+};
+
+/*
+ * Same check as pinMode(): entries of the variant table without port are not pins
+ */
+inline bool isPortPin(uint8_t pin) {
+	return pin < PINS_COUNT
+		&& g_APinDescription[pin].ulPort != NOT_A_PORT
+		&& g_APinDescription[pin].ulPinType != PIO_NOT_A_PIN;
+}
+
+/*
+ * Arduino pin resolved once at construction
+ * an invalid pin is bound to a RAM dummy port group: operations have no effect, read() returns false
+ */
+class GpioPin {
+	PortGroup *	_group;
+	uint32_t	_mask;
+	uint8_t		_bit;
+
+	static PortGroup * unusedGroup() {
+		static PortGroup group;
+		return &group;
+	}
+
+public:
+
+	GpioPin(uint8_t pin)
+		: _group(isPortPin(pin) ? &PORT->Group[g_APinDescription[pin].ulPort] : unusedGroup()),
+		  _mask(isPortPin(pin) ? 1ul << g_APinDescription[pin].ulPin : 0),
+		  _bit(isPortPin(pin) ? g_APinDescription[pin].ulPin : 0) {
+	}
+
+	bool valid() const {
+		return _mask != 0;
+	}
+
+	void output() {
+		_group->PINCFG[_bit].reg = PORT_PINCFG_INEN;
+		_group->DIRSET.reg = _mask;
+	}
+
+	void high() { _group->OUTSET.reg = _mask; }
+	void low() { _group->OUTCLR.reg = _mask; }
+	void toggle() { _group->OUTTGL.reg = _mask; }
+	void write(bool value) { if (value) high(); else low(); }
+	bool read() const { return (_group->IN.reg & _mask) != 0; }
+};
+
+/*
+ * Set of pins grouped by port: one mask per port group
+ */
+class PortMasks {
+	uint32_t _masks[PORT_GROUPS] = {};
+
+public:
+
+	PortMasks() = default;
+
+	PortMasks(std::initializer_list<uint8_t> pins) {
+		for (auto pin: pins) {
+			add(pin);
+		}
+	}
+
+	/*
+	 * Invalid pins are ignored
+	 */
+	void add(uint8_t pin) {
+		if (! isPortPin(pin) || g_APinDescription[pin].ulPort >= PORT_GROUPS)
+			return;
+		_masks[g_APinDescription[pin].ulPort] |= 1ul << g_APinDescription[pin].ulPin;
+	}
+
+	/*
+	 * Output low, input buffer / pull / peripheral mux disabled
+	 * a few stores per port group whatever the number of pins (WRCONFIG writes PINCFG of 16 pins at once)
+	 */
+	void setUnused() const {
+		for (uint8_t group = 0; group < PORT_GROUPS; group++) {
+			uint32_t mask = _masks[group];
+			if (mask == 0)
+				continue;
+			PortGroup & port = PORT->Group[group];
+			if (mask & 0xFFFF)
+				port.WRCONFIG.reg = PORT_WRCONFIG_WRPINCFG | PORT_WRCONFIG_PINMASK(mask & 0xFFFF);
+			if (mask >> 16)
+				port.WRCONFIG.reg = PORT_WRCONFIG_HWSEL | PORT_WRCONFIG_WRPINCFG | PORT_WRCONFIG_PINMASK(mask >> 16);
+			port.OUTCLR.reg = mask;
+			port.DIRSET.reg = mask;
+		}
+	}
+};
+
+#else
+
+#ifndef GPIO_TRAFFIC_PINS
+#define GPIO_TRAFFIC_PINS 0
+#endif
+
+/*
+ * Output traffic of pins [0, GPIO_TRAFFIC_PINS) through GpioPin and PortMasks
+ * 	GpioTraffic::of(LED_BUILTIN).writes
+ */
+struct GpioTraffic {
+	uint32_t	writes = 0;		// high(), low(), write(), setUnused()
+	uint32_t	toggles = 0;
+
+#if GPIO_TRAFFIC_PINS > 0
+	static GpioTraffic & of(uint8_t pin) {
+		static GpioTraffic traffic[GPIO_TRAFFIC_PINS + 1];	// last entry: pins out of range
+		return traffic[pin < GPIO_TRAFFIC_PINS ? pin : GPIO_TRAFFIC_PINS];
+	}
+
+	static void reset() {
+		for (uint16_t pin = 0; pin <= GPIO_TRAFFIC_PINS; pin++) {
+			of(pin) = GpioTraffic();
+		}
+	}
+
+	static void write(uint8_t pin) { of(pin).writes++; }
+	static void toggle(uint8_t pin) { of(pin).toggles++; }
+#else
+	static void write(uint8_t) {}
+	static void toggle(uint8_t) {}
+#endif
+};
+
+class GpioPin {
+	uint8_t _pin;
+
+public:
+
+	GpioPin(uint8_t pin): _pin(pin) {}
+
+	bool valid() const { return true; }	// checked by the Arduino API
+
+	void output() { pinMode(_pin, OUTPUT); }
+	void high() { GpioTraffic::write(_pin); digitalWrite(_pin, HIGH); }
+	void low() { GpioTraffic::write(_pin); digitalWrite(_pin, LOW); }
+	void toggle() { GpioTraffic::toggle(_pin); digitalWrite(_pin, !digitalRead(_pin)); }
+	void write(bool value) { GpioTraffic::write(_pin); digitalWrite(_pin, value ? HIGH : LOW); }
+	bool read() const { return digitalRead(_pin) != LOW; }
+};
+
+class PortMasks {
+	static constexpr uint8_t SIZ = 32;
+	uint8_t _pins[SIZ];
+	uint8_t _size = 0;
+
+public:
+
+	PortMasks() = default;
+
+	PortMasks(std::initializer_list<uint8_t> pins) {
+		for (auto pin: pins) {
+			add(pin);
+		}
+	}
+
+	void add(uint8_t pin) {
+		if (_size < SIZ)
+			_pins[_size++] = pin;
+	}
+
+	void setUnused() const {
+		for (uint8_t i = 0; i < _size; i++) {
+			pinMode(_pins[i], OUTPUT);
+			GpioTraffic::write(_pins[i]);
+			digitalWrite(_pins[i], LOW);
+		}
+	}
+};
+
+#endif
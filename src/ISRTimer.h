@@ -1,7 +1,7 @@
 /*
  * Module: ISRTimer
  *
- * Function: Timer & lowpower based on RTCZero & ArduinoLowPower
+ * Function: Timer & lowpower based on RTCZero & ArduinoLowPower, sub-second timeouts with LowPowerTimer
  *
  * Copyright and license: See accompanying LICENSE file.
  *
@@ -11,18 +11,39 @@
 #pragma once
 
 #include <LowPowerClock.h>
+#include <LowPowerTimer.h>
+#include <LatencyProbe.h>
 
 /*
  * ISRTimer class
+ *
+ * timeout is given in seconds (setTimeout) or in milliseconds (setTimeoutMs)
+ * the wake-up source is chosen by duration:
+ * - less than LowPowerTimer::MAX_MS (64 s): LowPowerTimer one-shot counter, 1/1024 s resolution (rounded up)
+ * - otherwise, or without LOW_POWER_TIMER: RTC calendar alarm, 1 second resolution (rounded up)
+ * both run in standby, hence short sensor warm-ups may use standbyMode() instead of loopFor()
+ *
+ * 	setTimeoutMs(250);		// ISR_timeoutMs() called in 250 ms
  */
 class ISRTimer {
 
 	static ISRTimer* _instance;
 
 	static void ISR_timer() {
+		LATENCY_PROBE(PROBE_ISR_TIMER);
 		_instance->disable();
-		_instance->_timeout = _instance->ISR_timeout(); // timeout may be adapted
-		if (_instance->_repeated) {
+		bool next = true;
+		if (_instance->_timeoutMs == 0) {
+			_instance->_timeout = _instance->ISR_timeout(); // timeout may be adapted
+		} else {
+			uint32_t timeoutMs = _instance->ISR_timeoutMs();
+			if (timeoutMs == 0) {
+				next = false;	// this expiry only, repetition is kept for later timeouts
+			} else {
+				_instance->_timeoutMs = timeoutMs;
+			}
+		}
+		if (_instance->_repeated && next) {
 			_instance->enable();
 		}
 	}
@@ -30,6 +51,7 @@ class ISRTimer {
 protected:
 
 	uint32_t	_timeout = 60*60;	// 1 hour
+	uint32_t	_timeoutMs = 0;		// milliseconds, replaces _timeout if not 0
 	bool 		_enabled = false;
 	bool 		_repeated = false;
 	bool		_beginDone = false;
@@ -67,9 +89,15 @@ public:
 	 */
 	virtual void enable() {
 		_enabled = true;
-		lowPowerClock.attachInterrupt(ISRTimer::ISR_timer);
-		lowPowerClock.setAlarmEpoch(lowPowerClock.getEpoch() + _timeout);
-		lowPowerClock.enableAlarm(lowPowerClock.MATCH_YYMMDDHHMMSS);
+		if (_timeoutMs != 0 && lowPowerTimer.AVAILABLE && _timeoutMs <= lowPowerTimer.MAX_MS) {
+			lowPowerTimer.attachInterrupt(ISRTimer::ISR_timer);
+			lowPowerTimer.start(_timeoutMs);
+		} else {
+			uint32_t timeout = (_timeoutMs == 0 ? _timeout : (_timeoutMs + 999) / 1000);
+			lowPowerClock.attachInterrupt(ISRTimer::ISR_timer);
+			lowPowerClock.setAlarmEpoch(lowPowerClock.getEpoch() + timeout);
+			lowPowerClock.enableAlarm(lowPowerClock.MATCH_YYMMDDHHMMSS);
+		}
 	}
 
 	/*
@@ -77,6 +105,8 @@ public:
 	 */
 	virtual void disable() {
 		_enabled = false;
+		lowPowerTimer.stop();
+		lowPowerTimer.detachInterrupt();
 		lowPowerClock.disableAlarm();
 		lowPowerClock.detachInterrupt();
 	}
@@ -120,6 +150,27 @@ public:
 				disable();
 			}
 			_timeout = timeout;
+			_timeoutMs = 0;
+			if (enabled) {
+				enable();
+			}
+			return true;
+		}
+	}
+
+	/*
+	 * Set the timeout value in milliseconds
+	 * ISR_timeoutMs() is then called instead of ISR_timeout()
+	 */
+	virtual bool setTimeoutMs(uint32_t timeoutMs) {
+		if (timeoutMs == 0) {
+			return false;
+		} else {
+			bool enabled = _enabled;
+			if (_enabled) {
+				disable();
+			}
+			_timeoutMs = timeoutMs;
 			if (enabled) {
 				enable();
 			}
@@ -136,7 +187,11 @@ public:
 	}
 
 	uint32_t getTimeout() {
-		return _timeout;
+		return _timeoutMs == 0 ? _timeout : (_timeoutMs + 999) / 1000;
+	}
+
+	uint32_t getTimeoutMs() {
+		return _timeoutMs == 0 ? _timeout * 1000 : _timeoutMs;
 	}
 	
 	/*
@@ -145,6 +200,19 @@ public:
 	 */
 	virtual uint32_t ISR_timeout() = 0;
 
+	/*
+	 * Called by interrupt when the timeout is given in milliseconds
+	 * returns the next timeout in milliseconds (0 = no next timeout, until setTimeout() or setTimeoutMs())
+	 * default: calls ISR_timeout(), keeps the same timeout unless ISR_timeout() adapted the period (seconds)
+	 */
+	virtual uint32_t ISR_timeoutMs() {
+		uint32_t timeout = ISR_timeout();
+		if (timeout == _timeout)
+			return _timeoutMs;
+		_timeout = timeout;
+		return (timeout > UINT32_MAX / 1000 ? UINT32_MAX - 999 : timeout * 1000);
+	}
+
 };
 
 /*
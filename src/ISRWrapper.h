@@ -11,6 +11,7 @@
 #pragma once
 
 #include <MemberFunction.h>
+#include <LatencyProbe.h>
 
 namespace lstl = leuville::simple_template_library;
 using namespace lstl;
@@ -36,6 +37,7 @@ private:
 	 * on if delay between this interrupt and the previous one is more than _delay
 	 */
 	static void ISR_commonCB() {
+		LATENCY_PROBE(PROBE_ISR_PIN);
 		if (_instance->_delay == 0)
 			_instance->ISR_callback(PIN);
 		else {
@@ -0,0 +1,209 @@
+/*
+ * Module: LatencyProbe
+ *
+ * Function: opt-in latency instrumentation of hot paths (ISR, callbacks, awake cycles)
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <CriticalSection.h>
+
+/*
+ * Probes are compiled only if LATENCY_PROBES is defined before including any library header
+ * (or with a build flag: -DLATENCY_PROBES), otherwise macros below expand to nothing
+ *
+ * 	LATENCY_PROBE(id)			measures the enclosing scope
+ * 	LATENCY_PROBE_START(id)		starts a measure which spans several scopes
+ * 	LATENCY_PROBE_STOP(id)		ends it (ignored if not started)
+ * 	LATENCY_PROBES_BEGIN()		enables the cycle counter when available
+ * 	LATENCY_PROBES_DUMP(printer)	prints statistics with a USBPrinter
+ *
+ * Durations are CPU cycles on cores providing DWT->CYCCNT (Cortex-M3/M4), micros() otherwise (SAMD21)
+ */
+#if defined(LATENCY_PROBES)
+
+#ifndef LATENCY_PROBES_USER_COUNT
+#define LATENCY_PROBES_USER_COUNT 4
+#endif
+
+/*
+ * Probes set by the library, application probes are PROBE_USER, PROBE_USER+1, ...
+ */
+enum LatencyProbeId : uint8_t {
+	PROBE_ISR_PIN,		// ISRWrapper::ISR_commonCB
+	PROBE_ISR_TIMER,	// ISRTimer::ISR_timer
+	PROBE_CALLBACK,		// CallbackRegister::execute
+	PROBE_AWAKE,		// between two LowPowerClock::standbyMode() calls
+	PROBE_USER,
+	PROBE_COUNT = PROBE_USER + LATENCY_PROBES_USER_COUNT
+};
+
+/*
+ * Statistics of one probe
+ * histogram[i] counts durations d such that 2^(i-1) <= d < 2^i (saturated at 0xFFFF)
+ */
+struct LatencyStats {
+	uint32_t	count = 0;
+	uint32_t	min = UINT32_MAX;
+	uint32_t	max = 0;
+	uint64_t	sum = 0;
+	uint32_t	start = 0;
+	bool		started = false;
+	uint16_t	histogram[32] = {};
+
+	void add(uint32_t duration) {
+		count++;
+		sum += duration;
+		if (duration < min) min = duration;
+		if (duration > max) max = duration;
+		uint8_t bucket = (duration == 0 ? 0 : 32 - __builtin_clz(duration));
+		if (bucket > 31) bucket = 31;
+		if (histogram[bucket] != UINT16_MAX) histogram[bucket]++;
+	}
+
+	uint32_t mean() const {
+		return (count == 0 ? 0 : static_cast<uint32_t>(sum / count));
+	}
+};
+
+class LatencyProbes {
+
+	LatencyStats _stats[PROBE_COUNT];
+
+	/*
+	 * Stats are shared by ISR of different priorities: updates must not be preempted
+	 * PrimaskLock restores the previous state, probes may be used inside a critical section
+	 */
+	void add(uint8_t id, uint32_t duration) {
+		leuville::simple_template_library::LockGuard<leuville::simple_template_library::PrimaskLock> guard;
+		_stats[id].add(duration);
+	}
+
+public:
+
+	static constexpr const char* UNIT =
+#if defined(DWT) && defined(DWT_CTRL_CYCCNTENA_Msk)
+		"cycles";
+#else
+		"us";
+#endif
+
+	/*
+	 * Enables the cycle counter if available
+	 */
+	void begin() {
+#if defined(DWT) && defined(DWT_CTRL_CYCCNTENA_Msk)
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	}
+
+	static inline uint32_t now() {
+#if defined(DWT) && defined(DWT_CTRL_CYCCNTENA_Msk)
+		return DWT->CYCCNT;
+#else
+		return micros();
+#endif
+	}
+
+	void start(uint8_t id) {
+		_stats[id].start = now();
+		_stats[id].started = true;
+	}
+
+	void stop(uint8_t id) {
+		uint32_t end = now();
+		if (_stats[id].started) {
+			_stats[id].started = false;
+			add(id, end - _stats[id].start);
+		}
+	}
+
+	void record(uint8_t id, uint32_t startTmst) {
+		add(id, now() - startTmst);
+	}
+
+	const LatencyStats & stats(uint8_t id) const {
+		return _stats[id];
+	}
+
+	void reset() {
+		for (uint8_t id = 0; id < PROBE_COUNT; id++) {
+			leuville::simple_template_library::LockGuard<leuville::simple_template_library::PrimaskLock> guard;
+			_stats[id] = LatencyStats();
+		}
+	}
+
+	/*
+	 * Prints count/min/max/mean and non empty histogram buckets of every used probe
+	 */
+	template <typename PRINTER>
+	void dump(PRINTER & printer) {
+		static const char* names[PROBE_USER] = { "isr_pin", "isr_timer", "callback", "awake" };
+		for (uint8_t id = 0; id < PROBE_COUNT; id++) {
+			LatencyStats stats = _stats[id];
+			if (stats.count == 0)
+				continue;
+			if (id < PROBE_USER) {
+				printer.print("probe ", names[id]);
+			} else {
+				printer.print("probe user", static_cast<uint8_t>(id - PROBE_USER));
+			}
+			printer.print(" unit=", UNIT);
+			printer.print(" n=", stats.count);
+			printer.print(" min=", stats.min);
+			printer.print(" max=", stats.max);
+			printer.println(" mean=", stats.mean());
+			for (uint8_t bucket = 0; bucket < 32; bucket++) {
+				if (stats.histogram[bucket] == 0)
+					continue;
+				printer.print("  <", 1UL << bucket);
+				printer.println(" : ", stats.histogram[bucket]);
+			}
+		}
+	}
+};
+
+/*
+ * "singleton"
+ */
+LatencyProbes latencyProbes;
+
+/*
+ * Measures the lifetime of the object
+ */
+struct ScopedLatencyProbe {
+	const uint8_t	_id;
+	const uint32_t	_start;
+
+	ScopedLatencyProbe(uint8_t id): _id(id), _start(LatencyProbes::now()) {}
+
+	~ScopedLatencyProbe() {
+		latencyProbes.record(_id, _start);
+	}
+};
+
+#define LATENCY_PROBE_CONCAT_(a, b) a##b
+#define LATENCY_PROBE_CONCAT(a, b) LATENCY_PROBE_CONCAT_(a, b)
+
+#define LATENCY_PROBE(id) ScopedLatencyProbe LATENCY_PROBE_CONCAT(_latencyProbe, __LINE__)(id)
+#define LATENCY_PROBE_START(id) latencyProbes.start(id)
+#define LATENCY_PROBE_STOP(id) latencyProbes.stop(id)
+#define LATENCY_PROBES_BEGIN() latencyProbes.begin()
+#define LATENCY_PROBES_DUMP(printer) latencyProbes.dump(printer)
+
+#else
+
+#define LATENCY_PROBE(id)
+#define LATENCY_PROBE_START(id) do {} while (0)
+#define LATENCY_PROBE_STOP(id) do {} while (0)
+#define LATENCY_PROBES_BEGIN() do {} while (0)
+#define LATENCY_PROBES_DUMP(printer) do {} while (0)
+
+#endif
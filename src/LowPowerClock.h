@@ -11,6 +11,7 @@
 #pragma once
 
 #include <RTCZero.h>
+#include <LatencyProbe.h>
 
 /*
  * LowPowerClock class
@@ -19,16 +20,122 @@ class LowPowerClock: public RTCZero {
 
 public:
 
+	enum WakeReason : uint8_t { WAKE_NONE, WAKE_ALARM, WAKE_PIN, WAKE_TIMER };
+
+	/*
+	 * Time spent in each power state
+	 *
+	 * active time is measured with millis() (stopped during standby)
+	 * standby time ended by LowPowerTimer is the programmed timeout minus the active time since start()
+	 * other standby periods are measured with the RTC, hence with a 1 second resolution
+	 */
+	struct PowerStats {
+		uint64_t	activeMs = 0;
+		uint64_t	standbyMs = 0;
+		uint32_t	alarmWakeups = 0;
+		uint32_t	pinWakeups = 0;
+		uint32_t	timerWakeups = 0;
+		uint32_t	lastStandbyEpoch = 0;	// RTC time when entering last standby
+		uint32_t	lastWakeEpoch = 0;		// RTC time when leaving last standby
+		WakeReason	lastWakeReason = WAKE_NONE;
+	};
+
+private:
+
+	static voidFuncPtr		_alarmCallback;
+	static volatile WakeReason	_wakeEvent;		// set by interrupts during standby
+	static volatile uint32_t	_timerStandbyMs;	// set by LowPowerTimer interrupt
+
+	voidFuncPtr		_standbyCallback = nullptr;
+	PowerStats		_stats;
+	unsigned long	_wakeTmst = 0;		// millis() when leaving last standby
+
+	/*
+	 * RTC alarm interrupt: records the wake-up reason then calls the attached function
+	 */
+	static void ISR_alarm() {
+		_wakeEvent = WAKE_ALARM;
+		if (_alarmCallback != nullptr) {
+			_alarmCallback();
+		}
+	}
+
+public:
+
+	/*
+	 * Called by LowPowerTimer interrupt (sub-second timeouts)
+	 * standbyMs: part of the timeout not spent active, i.e. in standby
+	 */
+	static void ISR_timerWake(uint32_t standbyMs) {
+		_wakeEvent = WAKE_TIMER;
+		_timerStandbyMs = standbyMs;
+	}
+
 	void begin(bool resetTime= false) {
 		if (! isConfigured()) {
 			RTCZero::begin(resetTime);
 		}
+		RTCZero::attachInterrupt(LowPowerClock::ISR_alarm);
+	}
+
+	/*
+	 * RTC alarm callback
+	 * The RTC interrupt stays attached to LowPowerClock in order to know the wake-up reason
+	 */
+	void attachInterrupt(voidFuncPtr callback) {
+		_alarmCallback = callback;
+		RTCZero::attachInterrupt(LowPowerClock::ISR_alarm);
+	}
+
+	void detachInterrupt() {
+		_alarmCallback = nullptr;
+	}
+
+	/*
+	 * Function called just before entering standby mode
+	 * (flush of buffered logs for instance)
+	 */
+	void attachStandbyCallback(voidFuncPtr callback) {
+		_standbyCallback = callback;
+	}
+
+	void detachStandbyCallback() {
+		_standbyCallback = nullptr;
+	}
+
+	/*
+	 * Power state statistics, including the current active period
+	 */
+	PowerStats getPowerStats() const {
+		PowerStats stats = _stats;
+		stats.activeMs += millis() - _wakeTmst;
+		return stats;
+	}
+
+	/*
+	 * Standby time accounted so far, ISR safe while the CPU is in standby
+	 */
+	uint64_t getStandbyMs() const {
+		return _stats.standbyMs;
+	}
+
+	void resetPowerStats() {
+		_stats = PowerStats();
+		_wakeTmst = millis();
 	}
 
 	/*
      * Stand by mode
      */
     void standbyMode() {
+		if (_standbyCallback != nullptr) {
+			_standbyCallback();
+		}
+		LATENCY_PROBE_STOP(PROBE_AWAKE);
+		_stats.activeMs += millis() - _wakeTmst;
+		_stats.lastStandbyEpoch = getEpoch();
+		_wakeEvent = WAKE_NONE;
+
 		bool restoreUSBDevice = false;
 		if (SERIAL_PORT_USBVIRTUAL) {
 			USBDevice.standby();
@@ -46,9 +153,35 @@ public:
 		if (restoreUSBDevice) {
 			USBDevice.attach();
 		}
+
+		_wakeTmst = millis();
+		_stats.lastWakeEpoch = getEpoch();
+		if (_wakeEvent == WAKE_TIMER) {
+			_stats.standbyMs += _timerStandbyMs;
+		} else {
+			_stats.standbyMs += 1000ULL * (_stats.lastWakeEpoch - _stats.lastStandbyEpoch);
+		}
+		if (_wakeEvent == WAKE_ALARM) {
+			_stats.lastWakeReason = WAKE_ALARM;
+			_stats.alarmWakeups++;
+		} else if (_wakeEvent == WAKE_TIMER) {
+			_stats.lastWakeReason = WAKE_TIMER;
+			_stats.timerWakeups++;
+		} else {
+			_stats.lastWakeReason = WAKE_PIN;
+			_stats.pinWakeups++;
+		}
+		LATENCY_PROBE_START(PROBE_AWAKE);
 	}
 };
 
+/*
+ * Declares and init static variables (link purpose)
+ */
+voidFuncPtr LowPowerClock::_alarmCallback = nullptr;
+volatile LowPowerClock::WakeReason LowPowerClock::_wakeEvent = WAKE_NONE;
+volatile uint32_t LowPowerClock::_timerStandbyMs = 0;
+
 /*
  * "singleton"
  */
@@ -0,0 +1,182 @@
+/*
+ * Module: LowPowerTimer
+ *
+ * Function: sub-second one-shot timer running in standby (TC4 clocked from the 32 kHz oscillator)
+ *
+ * Copyright and license: See accompanying LICENSE file.
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <LowPowerClock.h>
+
+/*
+ * One-shot timer with a 1/1024 s resolution, up to MAX_MS milliseconds
+ *
+ * RTCZero keeps the RTC in calendar mode (1 second alarms), hence short timeouts use TC4:
+ * COUNT16 counter clocked by GCLK4 = 32 kHz oscillator / 32, both running in standby
+ * the oscillator is the one used by RTCZero (XOSC32K, or OSCULP32K with CRYSTALLESS)
+ *
+ * TC4 and TC5 share their clock: Servo (TC4) and tone() (TC5) can not be used with LowPowerTimer
+ *
+ * Compiled only if LOW_POWER_TIMER is defined before including any library header
+ * (or with a build flag: -DLOW_POWER_TIMER), as it defines TC4_Handler():
+ * include it from one translation unit only, like LowPowerClock
+ * TC4 and GCLK4 are configured at the first start(), not by begin() of ISRTimer
+ *
+ * Without LOW_POWER_TIMER or TC4 (other architectures), AVAILABLE is false and start() returns false
+ */
+class LowPowerTimer {
+
+	static voidFuncPtr	_callback;
+
+public:
+
+	static constexpr uint32_t FREQUENCY = 1024;		// Hz
+	static constexpr uint32_t MAX_MS = 63999;		// 16-bit counter
+
+#if defined(LOW_POWER_TIMER) && defined(ARDUINO_ARCH_SAMD) && ! defined(__SAMD51__)
+
+	static constexpr bool AVAILABLE = true;
+
+private:
+
+	bool	_beginDone = false;
+	static uint32_t			_startTmst;		// millis() at start(), millis() is stopped during standby
+	static uint64_t			_startStandbyMs;	// standby time already accounted at start()
+	static uint32_t			_timeoutMs;
+
+	static void syncTC() {
+		while (TC4->COUNT16.STATUS.bit.SYNCBUSY);
+	}
+
+	static void syncGCLK() {
+		while (GCLK->STATUS.bit.SYNCBUSY);
+	}
+
+public:
+
+	/*
+	 * Called from TC4 interrupt (see TC4_Handler below)
+	 */
+	static void ISR_overflow() {
+		TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+		// standby part of the timeout, minus standby periods already accounted (earlier pin wake-ups)
+		uint32_t active = millis() - _startTmst;
+		uint64_t standby = (active < _timeoutMs ? _timeoutMs - active : 0);
+		uint64_t accounted = lowPowerClock.getStandbyMs();
+		accounted = (accounted > _startStandbyMs ? accounted - _startStandbyMs : 0);
+		LowPowerClock::ISR_timerWake(standby > accounted ? standby - accounted : 0);
+		if (_callback != nullptr) {
+			_callback();
+		}
+	}
+
+	/*
+	 * To be called after lowPowerClock.begin() (32 kHz oscillator configured by RTCZero)
+	 * called by start() if needed
+	 */
+	void begin() {
+		if (_beginDone)
+			return;
+		GCLK->GENDIV.reg = GCLK_GENDIV_ID(4) | GCLK_GENDIV_DIV(4);	// 2^(4+1) = 32
+		syncGCLK();
+#ifdef CRYSTALLESS
+		GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(4) | GCLK_GENCTRL_GENEN | GCLK_GENCTRL_SRC_OSCULP32K | GCLK_GENCTRL_DIVSEL | GCLK_GENCTRL_RUNSTDBY;
+#else
+		GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(4) | GCLK_GENCTRL_GENEN | GCLK_GENCTRL_SRC_XOSC32K | GCLK_GENCTRL_DIVSEL | GCLK_GENCTRL_RUNSTDBY;
+#endif
+		syncGCLK();
+		GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_TC4_TC5 | GCLK_CLKCTRL_GEN_GCLK4 | GCLK_CLKCTRL_CLKEN;
+		syncGCLK();
+		PM->APBCMASK.reg |= PM_APBCMASK_TC4;
+
+		TC4->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+		while (TC4->COUNT16.CTRLA.bit.SWRST);
+		// MFRQ: counter wraps (OVF) when reaching CC0
+		TC4->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV1 | TC_CTRLA_RUNSTDBY;
+		syncTC();
+		TC4->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+		NVIC_ClearPendingIRQ(TC4_IRQn);
+		NVIC_EnableIRQ(TC4_IRQn);
+		_beginDone = true;
+	}
+
+	/*
+	 * Starts a one-shot timeout, a running timeout is restarted
+	 * returns false if ms is 0 or more than MAX_MS
+	 */
+	bool start(uint32_t ms) {
+		if (ms == 0 || ms > MAX_MS)
+			return false;
+		begin();
+		stop();
+		uint32_t ticks = (ms * FREQUENCY + 999) / 1000;		// rounded up: never shorter than ms
+		TC4->COUNT16.COUNT.reg = 0;
+		syncTC();
+		TC4->COUNT16.CC[0].reg = static_cast<uint16_t>(ticks - 1);
+		syncTC();
+		TC4->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+		syncTC();
+		TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+		_startTmst = millis();
+		_startStandbyMs = lowPowerClock.getStandbyMs();
+		_timeoutMs = ms;
+		TC4->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+		syncTC();
+		return true;
+	}
+
+	void stop() {
+		if (! _beginDone)
+			return;
+		TC4->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+		syncTC();
+		TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+	}
+
+#else
+
+	static constexpr bool AVAILABLE = false;
+
+	void begin() {}
+
+	bool start(uint32_t ms) {
+		return false;
+	}
+
+	void stop() {}
+
+#endif
+
+	void attachInterrupt(voidFuncPtr callback) {
+		_callback = callback;
+	}
+
+	void detachInterrupt() {
+		_callback = nullptr;
+	}
+};
+
+/*
+ * Declares and init static variables (link purpose)
+ */
+voidFuncPtr LowPowerTimer::_callback = nullptr;
+#if defined(LOW_POWER_TIMER) && defined(ARDUINO_ARCH_SAMD) && ! defined(__SAMD51__)
+uint32_t LowPowerTimer::_startTmst = 0;
+uint64_t LowPowerTimer::_startStandbyMs = 0;
+uint32_t LowPowerTimer::_timeoutMs = 0;
+#endif
+
+/*
+ * "singleton"
+ */
+LowPowerTimer lowPowerTimer;
+
+#if defined(LOW_POWER_TIMER) && defined(ARDUINO_ARCH_SAMD) && ! defined(__SAMD51__)
+extern "C" void TC4_Handler() {
+	LowPowerTimer::ISR_overflow();
+}
+#endif
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Arduino.h>
+#include <CriticalSection.h>
+
+namespace leuville {
+namespace simple_template_library {
+
+/*
+ * Fixed-size multi-producer / single-consumer queue
+ *
+ * push() may be called from ISRs of any priority (ISRTimer::ISR_timer, ISRWrapper pins...) and from the loop:
+ * a producer reserves a slot with compareExchange() on the tail (LDREX/STREX on M3/M4,
+ * a few instructions with PRIMASK set on M0+), then copies its element outside of any critical section
+ * and publishes it through the sequence number of the slot
+ *
+ * pop() is called by a single consumer (the loop): elements are delivered in reservation order,
+ * an element reserved but not yet published (producer preempted) stops pop() until it is published
+ *
+ * SIZ must be a power of 2
+ */
+template <typename T, uint8_t SIZ = 16>
+class MpscQueue {
+
+	static_assert(SIZ >= 2 && (SIZ & (SIZ - 1)) == 0, "SIZ must be a power of 2");
+
+protected:
+
+	/*
+	 * seq == position: free for the producer of position
+	 * seq == position + 1: published, readable by the consumer
+	 */
+	struct Cell {
+		volatile uint32_t	seq;
+		T					data;
+	};
+
+	Cell				_cells[SIZ];
+	volatile uint32_t	_tail = 0;		// next position to reserve
+	uint32_t			_head = 0;		// next position to read (consumer only)
+	volatile uint32_t	_dropped = 0;
+
+	static uint32_t loadAcquire(const volatile uint32_t & word) {
+		return __atomic_load_n(&word, __ATOMIC_ACQUIRE);
+	}
+
+	static void storeRelease(volatile uint32_t & word, uint32_t value) {
+		__atomic_store_n(&word, value, __ATOMIC_RELEASE);
+	}
+
+public:
+
+	MpscQueue() {
+		for (uint8_t i = 0; i < SIZ; i++) {
+			_cells[i].seq = i;
+		}
+	}
+
+	MpscQueue(const MpscQueue &) = delete;
+	MpscQueue & operator=(const MpscQueue &) = delete;
+
+	constexpr uint8_t max_size() const {
+		return SIZ;
+	}
+
+	/*
+	 * Producer side, ISR-safe
+	 * returns false if the queue is full (counted in dropped())
+	 */
+	bool push(const T & elt) {
+		uint32_t pos = loadAcquire(_tail);
+		Cell * cell;
+		for (;;) {
+			cell = &_cells[pos & (SIZ - 1)];
+			int32_t diff = static_cast<int32_t>(loadAcquire(cell->seq) - pos);
+			if (diff == 0) {
+				if (compareExchange<uint32_t>(_tail, pos, pos + 1))
+					break;
+				// pos reloaded by compareExchange
+			} else if (diff < 0) {
+				uint32_t dropped = loadAcquire(_dropped);
+				while (! compareExchange<uint32_t>(_dropped, dropped, dropped + 1)) {}
+				return false;
+			} else {
+				pos = loadAcquire(_tail);
+			}
+		}
+		cell->data = elt;
+		storeRelease(cell->seq, pos + 1);
+		return true;
+	}
+
+	/*
+	 * Consumer side (single consumer)
+	 * returns false if empty or if the oldest reserved element is not published yet
+	 */
+	bool pop(T & elt) {
+		Cell & cell = _cells[_head & (SIZ - 1)];
+		if (loadAcquire(cell.seq) != _head + 1)
+			return false;
+		elt = cell.data;
+		storeRelease(cell.seq, _head + SIZ);
+		_head++;
+		return true;
+	}
+
+	/*
+	 * Reserved elements, published or not (approximate when producers are running)
+	 */
+	uint8_t size() const {
+		return static_cast<uint8_t>(loadAcquire(_tail) - _head);
+	}
+
+	bool empty() const {
+		return loadAcquire(_tail) == _head;
+	}
+
+	/*
+	 * Number of elements rejected because the queue was full
+	 */
+	uint32_t dropped() const {
+		return loadAcquire(_dropped);
+	}
+};
+
+}
+}
@@ -0,0 +1,555 @@
+/*
+ * Module: PersistentStore
+ *
+ * Function: wear-levelled persistent records (POD, ArrayMap snapshots) in flash
+ *
+ * Copyright and license: See accompanying LICENSE file
+ *
+ * Author: Laurent Nel
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+#include <Crc.h>
+
+/*
+ * Append-only log of records stored in a ring of flash sectors
+ *
+ * FLASH is the storage backend (SamdFlash, MappedFileFlash) which provides:
+ * 	- SECTOR_SIZE (erase unit of the store), SECTORS
+ * 	- erase(sector), read(addr, data, len), write(addr, data, len) with flash semantic (bits 1 -> 0)
+ *
+ * Sector layout:
+ * 	magic (4) | sequence (4) | tail table (TAIL_ENTRIES x 2) | records
+ * Record layout (4 bytes aligned):
+ * 	id (2) | length (2) | payload | CRC-16/CCITT (2) | padding
+ *
+ * - the tail table holds the end offset of each record: the append position is found
+ *   at boot by a binary search on it, without scanning records
+ * - the tail entry is written before the record, a torn record is detected by its crc
+ * - all live records are in the active sector: when it is full, the next sector of the ring
+ *   is erased, live records are copied, then its header is written (wear levelling + compaction)
+ */
+template <typename FLASH, uint8_t TAIL_ENTRIES = 32, uint8_t MAX_IDS = 16>
+class PersistentStore {
+
+	static constexpr uint32_t MAGIC = 0x4C505331;		// "LPS1"
+	static constexpr uint16_t EMPTY = 0xFFFF;
+	static constexpr uint16_t DELETED = 0x8000;		// length flag
+	static constexpr uint16_t HEADER_SIZE = 8 + 2 * TAIL_ENTRIES;
+
+	static_assert(FLASH::SECTORS >= 2, "at least 2 sectors are needed");
+	static_assert(FLASH::SECTOR_SIZE <= 0x10000, "sector offsets are 16 bits");
+
+protected:
+
+	FLASH &		_flash;
+	uint8_t		_sector = 0;		// active sector
+	uint32_t	_sequence = 0;
+	uint8_t		_count = 0;			// records in active sector
+	uint16_t	_tail = HEADER_SIZE;	// append offset in active sector
+	Crc16Ccitt<CRC_NIBBLE>	_crc;	// record being written
+	uint32_t	_writePos = 0;
+
+	static uint16_t align(uint32_t size) {
+		return (size + 3) & ~3u;
+	}
+
+	static uint16_t recordSize(uint16_t len) {
+		return align(4 + (len & ~DELETED) + 2);
+	}
+
+	uint32_t base(uint8_t sector) const {
+		return static_cast<uint32_t>(sector) * FLASH::SECTOR_SIZE;
+	}
+
+	uint16_t tailEntry(uint8_t sector, uint8_t index) const {
+		uint16_t value;
+		_flash.read(base(sector) + 8 + 2 * index, &value, 2);
+		return value;
+	}
+
+	/*
+	 * Start offset of record index of a sector
+	 */
+	uint16_t recordStart(uint8_t sector, uint8_t index) const {
+		return (index == 0 ? HEADER_SIZE : tailEntry(sector, index - 1));
+	}
+
+	/*
+	 * Number of records of a sector: binary search of the first empty tail entry
+	 */
+	uint8_t countRecords(uint8_t sector) const {
+		uint8_t low = 0, high = TAIL_ENTRIES;
+		while (low < high) {
+			uint8_t mid = (low + high) / 2;
+			if (tailEntry(sector, mid) == EMPTY)
+				high = mid;
+			else
+				low = mid + 1;
+		}
+		return low;
+	}
+
+	/*
+	 * Reads and checks record index of a sector
+	 * returns false if the record is torn (bad crc)
+	 */
+	bool readHeader(uint8_t sector, uint8_t index, uint16_t & id, uint16_t & len, uint32_t & payload) const {
+		uint32_t addr = base(sector) + recordStart(sector, index);
+		uint16_t header[2];
+		_flash.read(addr, header, 4);
+		id = header[0];
+		len = header[1];
+		if (id == EMPTY || recordSize(len) > FLASH::SECTOR_SIZE - HEADER_SIZE)
+			return false;
+		payload = addr + 4;
+		Crc16Ccitt<CRC_NIBBLE> crc;
+		crc.update(header, 4);
+		uint8_t buffer[32];
+		uint16_t size = len & ~DELETED;
+		for (uint16_t done = 0; done < size; ) {
+			uint16_t chunk = size - done;
+			if (chunk > sizeof buffer) chunk = sizeof buffer;
+			_flash.read(payload + done, buffer, chunk);
+			crc.update(buffer, chunk);
+			done += chunk;
+		}
+		uint16_t stored;
+		_flash.read(payload + size, &stored, 2);
+		return stored == crc.value();
+	}
+
+	/*
+	 * Index of the last valid record of id in active sector, -1 if not found or deleted
+	 */
+	int16_t find(uint16_t id, uint16_t & len, uint32_t & payload) const {
+		for (int16_t i = _count - 1; i >= 0; i--) {
+			uint16_t recId;
+			if (readHeader(_sector, i, recId, len, payload) && recId == id) {
+				return (len & DELETED) ? -1 : i;
+			}
+		}
+		return -1;
+	}
+
+	void writeHeader(uint8_t sector, uint32_t sequence) {
+		uint32_t header[2] = { MAGIC, sequence };
+		_flash.write(base(sector), header, 8);
+	}
+
+	/*
+	 * Moves live records into the next sector of the ring
+	 */
+	bool compact(uint16_t needed) {
+		uint8_t next = (_sector + 1) % FLASH::SECTORS;
+
+		// live records (last record of each id, not deleted), checked before erasing the next sector
+		uint16_t ids[MAX_IDS];
+		uint8_t nbIds = 0;
+		uint32_t froms[MAX_IDS];
+		uint16_t sizes[MAX_IDS];
+		uint8_t count = 0;
+		uint16_t tail = HEADER_SIZE;
+		for (int16_t i = _count - 1; i >= 0; i--) {
+			uint16_t id, len;
+			uint32_t payload;
+			if (! readHeader(_sector, i, id, len, payload))
+				continue;
+			bool seen = false;
+			for (uint8_t j = 0; j < nbIds && ! seen; j++) {
+				seen = (ids[j] == id);
+			}
+			if (seen)
+				continue;
+			if (nbIds == MAX_IDS)
+				return false;
+			ids[nbIds++] = id;
+			if (len & DELETED)
+				continue;
+			froms[count] = payload - 4;
+			sizes[count] = recordSize(len);
+			tail += sizes[count];
+			count++;
+		}
+		if (count >= TAIL_ENTRIES || tail + needed > FLASH::SECTOR_SIZE)
+			return false;
+
+		_flash.erase(next);
+		tail = HEADER_SIZE;
+		for (uint8_t i = 0; i < count; i++) {
+			// copy whole record
+			uint16_t end = tail + sizes[i];
+			_flash.write(base(next) + 8 + 2 * i, &end, 2);
+			uint8_t buffer[32];
+			for (uint16_t done = 0; done < sizes[i]; done += sizeof buffer) {
+				uint16_t chunk = sizes[i] - done;
+				if (chunk > sizeof buffer) chunk = sizeof buffer;
+				_flash.read(froms[i] + done, buffer, chunk);
+				_flash.write(base(next) + tail + done, buffer, chunk);
+			}
+			tail = end;
+		}
+		// header written last: the new sector becomes active only if the copy is complete
+		writeHeader(next, ++_sequence);
+		_sector = next;
+		_count = count;
+		_tail = tail;
+		return true;
+	}
+
+	/*
+	 * Record writing: beginRecord() + appendPayload()* + endRecord()
+	 */
+	bool beginRecord(uint16_t id, uint16_t len) {
+		uint16_t size = recordSize(len);
+		if (id == EMPTY || size > FLASH::SECTOR_SIZE - HEADER_SIZE)
+			return false;
+		if (_count == TAIL_ENTRIES || _tail + size > FLASH::SECTOR_SIZE) {
+			if (! compact(size))
+				return false;
+		}
+		uint16_t end = _tail + size;
+		_flash.write(base(_sector) + 8 + 2 * _count, &end, 2);
+		uint16_t header[2] = { id, len };
+		_writePos = base(_sector) + _tail;
+		_flash.write(_writePos, header, 4);
+		_writePos += 4;
+		_crc.reset();
+		_crc.update(header, 4);
+		_count++;
+		_tail = end;
+		return true;
+	}
+
+	void appendPayload(const void* data, uint16_t len) {
+		_flash.write(_writePos, data, len);
+		_crc.update(data, len);
+		_writePos += len;
+	}
+
+	void endRecord() {
+		uint16_t crc = _crc.value();
+		_flash.write(_writePos, &crc, 2);
+	}
+
+public:
+
+	PersistentStore(FLASH & flash): _flash(flash) {}
+
+	/*
+	 * Finds the active sector (highest sequence) and its tail
+	 * formats the storage if no valid sector is found
+	 */
+	void begin() {
+		bool found = false;
+		for (uint8_t sector = 0; sector < FLASH::SECTORS; sector++) {
+			uint32_t header[2];
+			_flash.read(base(sector), header, 8);
+			if (header[0] == MAGIC && (! found || header[1] > _sequence)) {
+				found = true;
+				_sector = sector;
+				_sequence = header[1];
+			}
+		}
+		if (! found) {
+			_sector = 0;
+			_sequence = 1;
+			_flash.erase(_sector);
+			writeHeader(_sector, _sequence);
+		}
+		_count = countRecords(_sector);
+		_tail = (_count == 0 ? HEADER_SIZE : tailEntry(_sector, _count - 1));
+	}
+
+	/*
+	 * Saves a record (payload up to sector size), replacing previous record with same id
+	 * id 0xFFFF is reserved
+	 */
+	bool save(uint16_t id, const void* data, uint16_t len) {
+		if (len & DELETED)
+			return false;
+		if (! beginRecord(id, len))
+			return false;
+		appendPayload(data, len);
+		endRecord();
+		return true;
+	}
+
+	template <typename T>
+	bool save(uint16_t id, const T & value) {
+		static_assert(std::is_trivially_copyable<T>::value, "persisted records must be POD");
+		return save(id, &value, sizeof(T));
+	}
+
+	/*
+	 * Loads the last record saved with id
+	 * returns the stored payload length (data truncated to len), -1 if not found
+	 */
+	int32_t load(uint16_t id, void* data, uint16_t len) const {
+		uint16_t size;
+		uint32_t payload;
+		if (find(id, size, payload) < 0)
+			return -1;
+		_flash.read(payload, data, (size < len ? size : len));
+		return size;
+	}
+
+	template <typename T>
+	bool load(uint16_t id, T & value) const {
+		static_assert(std::is_trivially_copyable<T>::value, "persisted records must be POD");
+		return load(id, &value, sizeof(T)) == sizeof(T);
+	}
+
+	bool remove(uint16_t id) {
+		if (! beginRecord(id, DELETED))
+			return false;
+		endRecord();
+		return true;
+	}
+
+	/*
+	 * Snapshot of an ArrayMap whose keys and values are POD
+	 * payload: count (1) | (key, value) * count
+	 */
+	template <typename MAP>
+	bool saveMap(uint16_t id, MAP & map) {
+		using K = typename std::remove_reference<decltype(map.key(0))>::type;
+		using V = typename std::remove_reference<decltype(map.value(0))>::type;
+		static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+			"persisted map keys and values must be POD");
+		uint8_t count = map.size();
+		if (! beginRecord(id, 1 + count * (sizeof(K) + sizeof(V))))
+			return false;
+		appendPayload(&count, 1);
+		for (uint8_t i = 0; i < count; i++) {
+			appendPayload(&map.key(i), sizeof(K));
+			appendPayload(&map.value(i), sizeof(V));
+		}
+		endRecord();
+		return true;
+	}
+
+	/*
+	 * Restores a map snapshot (entries are put into map)
+	 */
+	template <typename MAP>
+	bool loadMap(uint16_t id, MAP & map) const {
+		using K = typename std::remove_reference<decltype(map.key(0))>::type;
+		using V = typename std::remove_reference<decltype(map.value(0))>::type;
+		uint16_t size;
+		uint32_t payload;
+		if (find(id, size, payload) < 0 || size < 1)
+			return false;
+		uint8_t count;
+		_flash.read(payload++, &count, 1);
+		if (size != 1 + count * (sizeof(K) + sizeof(V)))
+			return false;
+		for (uint8_t i = 0; i < count; i++) {
+			K key;
+			V value;
+			_flash.read(payload, &key, sizeof(K));
+			_flash.read(payload + sizeof(K), &value, sizeof(V));
+			payload += sizeof(K) + sizeof(V);
+			map.put(key, value);
+		}
+		return true;
+	}
+
+	uint8_t activeSector() const {
+		return _sector;
+	}
+
+	uint32_t sequence() const {
+		return _sequence;
+	}
+
+	/*
+	 * Free bytes in active sector
+	 */
+	uint16_t available() const {
+		return FLASH::SECTOR_SIZE - _tail;
+	}
+};
+
+#if defined(ARDUINO_ARCH_SAMD) && ! defined(__SAMD51__)
+
+#include <Arduino.h>
+
+/*
+ * Flash region image in erased state (0xFF)
+ */
+template <uint32_t SIZE>
+struct ErasedFlashRegion {
+	uint8_t data[SIZE];
+
+	constexpr ErasedFlashRegion(): data() {
+		for (uint32_t i = 0; i < SIZE; i++) {
+			data[i] = 0xFF;
+		}
+	}
+};
+
+/*
+ * Declares a flash region usable by SamdFlash (row aligned, in erased state)
+ *
+ * the region is part of the firmware image: each upload rewrites it to 0xFF, hence resets the store
+ * to keep records across uploads, place the region at a fixed address outside of the image
+ * (NOLOAD section of a custom linker script) and give this address to SamdFlash
+ */
+#define PERSISTENT_REGION(name, size) \
+	__attribute__((__aligned__(256))) static constexpr ErasedFlashRegion<size> name##_region {}; \
+	static const uint8_t * const name = name##_region.data
+
+/*
+ * SAMD21 NVM backend
+ * a sector is made of SECTOR_SIZE / 256 rows (erase unit), writes use the 64 bytes page buffer
+ */
+template <uint32_t SECTOR_SIZE_ = 1024, uint8_t SECTORS_ = 4>
+class SamdFlash {
+
+	static constexpr uint32_t ROW_SIZE = 256;
+	static constexpr uint32_t PAGE_SIZE = 64;
+
+	static_assert(SECTOR_SIZE_ % ROW_SIZE == 0, "sector size must be a multiple of NVM row size");
+
+	const volatile uint8_t * _base;
+
+	static void waitReady() {
+		while (NVMCTRL->INTFLAG.bit.READY == 0) {}
+	}
+
+	static void command(uint32_t cmd) {
+		NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | cmd;
+		waitReady();
+	}
+
+public:
+
+	static constexpr uint32_t SECTOR_SIZE = SECTOR_SIZE_;
+	static constexpr uint8_t SECTORS = SECTORS_;
+
+	/*
+	 * base: region declared with PERSISTENT_REGION(name, SECTOR_SIZE * SECTORS)
+	 */
+	SamdFlash(const uint8_t * base): _base(base) {}
+
+	void erase(uint8_t sector) {
+		for (uint32_t row = 0; row < SECTOR_SIZE; row += ROW_SIZE) {
+			NVMCTRL->ADDR.reg = reinterpret_cast<uint32_t>(_base + sector * SECTOR_SIZE + row) / 2;
+			command(NVMCTRL_CTRLA_CMD_ER);
+		}
+	}
+
+	void read(uint32_t addr, void * data, uint32_t len) const {
+		uint8_t * dst = static_cast<uint8_t*>(data);
+		for (uint32_t i = 0; i < len; i++) {
+			dst[i] = _base[addr + i];
+		}
+	}
+
+	/*
+	 * The page buffer is written by half-words (byte writes are not allowed):
+	 * an odd start or end is completed with the byte already in flash, which keeps its value
+	 * untouched half-words stay 0xFFFF and keep their programmed value
+	 */
+	void write(uint32_t addr, const void * data, uint32_t len) {
+		const uint8_t * src = static_cast<const uint8_t*>(data);
+		NVMCTRL->CTRLB.bit.MANW = 1;
+		while (len > 0) {
+			uint32_t pageEnd = (addr & ~(PAGE_SIZE - 1)) + PAGE_SIZE;
+			uint32_t chunk = (len < pageEnd - addr ? len : pageEnd - addr);
+			command(NVMCTRL_CTRLA_CMD_PBC);
+			uint32_t start = addr & ~1u;
+			uint32_t end = addr + chunk;
+			volatile uint16_t * dst = reinterpret_cast<volatile uint16_t*>(const_cast<uint8_t*>(_base) + start);
+			for (uint32_t pos = start; pos < end; pos += 2) {
+				uint8_t low = (pos >= addr ? src[pos - addr] : _base[pos]);
+				uint8_t high = (pos + 1 < end ? src[pos + 1 - addr] : _base[pos + 1]);
+				*dst++ = low | (static_cast<uint16_t>(high) << 8);
+			}
+			command(NVMCTRL_CTRLA_CMD_WP);
+			addr += chunk;
+			src += chunk;
+			len -= chunk;
+		}
+	}
+};
+
+#endif
+
+#if defined(__linux__) && ! defined(ARDUINO)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Linux backend: memory-mapped file simulating NOR flash
+ * erase sets a whole sector to 0xFF, write can only clear bits, erase cycles are counted
+ */
+template <uint32_t SECTOR_SIZE_ = 1024, uint8_t SECTORS_ = 4>
+class MappedFileFlash {
+
+	uint8_t *	_data = nullptr;
+	int			_fd = -1;
+	uint32_t	_eraseCounts[SECTORS_] = {};
+
+public:
+
+	static constexpr uint32_t SECTOR_SIZE = SECTOR_SIZE_;
+	static constexpr uint8_t SECTORS = SECTORS_;
+	static constexpr uint32_t SIZE = SECTOR_SIZE * SECTORS;
+
+	~MappedFileFlash() {
+		if (_data != nullptr) munmap(_data, SIZE);
+		if (_fd >= 0) close(_fd);
+	}
+
+	/*
+	 * Opens (or creates erased) the file backing the flash
+	 */
+	bool begin(const char * path) {
+		_fd = open(path, O_RDWR | O_CREAT, 0644);
+		if (_fd < 0)
+			return false;
+		struct stat st;
+		bool created = (fstat(_fd, &st) == 0 && st.st_size == 0);
+		if (ftruncate(_fd, SIZE) != 0)
+			return false;
+		void * data = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+		if (data == MAP_FAILED)
+			return false;
+		_data = static_cast<uint8_t*>(data);
+		if (created)
+			memset(_data, 0xFF, SIZE);
+		return true;
+	}
+
+	void erase(uint8_t sector) {
+		memset(_data + sector * SECTOR_SIZE, 0xFF, SECTOR_SIZE);
+		_eraseCounts[sector]++;
+	}
+
+	void read(uint32_t addr, void * data, uint32_t len) const {
+		memcpy(data, _data + addr, len);
+	}
+
+	void write(uint32_t addr, const void * data, uint32_t len) {
+		const uint8_t * src = static_cast<const uint8_t*>(data);
+		for (uint32_t i = 0; i < len; i++) {
+			_data[addr + i] &= src[i];
+		}
+	}
+
+	uint32_t eraseCount(uint8_t sector) const {
+		return _eraseCounts[sector];
+	}
+};
+
+#endif
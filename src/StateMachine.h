@@ -0,0 +1,178 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArrayDeque.h>
+
+namespace leuville {
+namespace simple_template_library {
+
+/*
+ * Row of a transition table: in state, on event, if guard (nullptr = always), call action (nullptr = none)
+ * then go to next
+ * guard and action are member functions of the target V
+ */
+template <typename V>
+struct FsmTransition {
+	uint8_t	state;
+	uint8_t	event;
+	bool	(V::*guard)();
+	void	(V::*action)();
+	uint8_t	next;
+};
+
+/*
+ * Not constexpr: called while building an FsmTable, it makes compilation fail
+ */
+inline void fsmTableOutOfRange() {}
+
+/*
+ * Transition table compiled at compile time into a dense (state, event) -> transition lookup
+ * rows with the same (state, event) are tried in declaration order (guarded alternatives)
+ *
+ * a state or event out of range makes the constexpr construction fail
+ */
+template <typename V, uint8_t STATES, uint8_t EVENTS, size_t N>
+struct FsmTable {
+
+	static_assert(N < 255, "too many transitions");
+
+	using Target = V;
+	static constexpr uint8_t NONE = 0xFF;
+	static constexpr uint8_t STATE_COUNT = STATES;
+	static constexpr uint8_t EVENT_COUNT = EVENTS;
+
+	FsmTransition<V>	transitions[N] {};
+	uint8_t				alternatives[N] {};			// next row with same (state, event)
+	uint8_t				lookup[STATES][EVENTS] {};	// first row of (state, event)
+
+	constexpr FsmTable(const FsmTransition<V> (&table)[N]) {
+		for (uint8_t s = 0; s < STATES; s++) {
+			for (uint8_t e = 0; e < EVENTS; e++) {
+				lookup[s][e] = NONE;
+			}
+		}
+		for (uint8_t i = 0; i < N; i++) {
+			transitions[i] = table[i];
+			alternatives[i] = NONE;
+			if (table[i].state >= STATES || table[i].next >= STATES || table[i].event >= EVENTS)
+				fsmTableOutOfRange();
+			uint8_t & first = lookup[table[i].state][table[i].event];
+			if (first == NONE) {
+				first = i;
+			} else {
+				uint8_t last = first;
+				while (alternatives[last] != NONE) last = alternatives[last];
+				alternatives[last] = i;
+			}
+		}
+	}
+};
+
+/*
+ * 	constexpr auto table = makeFsmTable<STATE_COUNT, EVENT_COUNT>(Device::transitions);
+ */
+template <uint8_t STATES, uint8_t EVENTS, typename V, size_t N>
+constexpr FsmTable<V, STATES, EVENTS, N> makeFsmTable(const FsmTransition<V> (&table)[N]) {
+	return FsmTable<V, STATES, EVENTS, N>(table);
+}
+
+/*
+ * Finite state machine driven by a constexpr FsmTable (stored in flash)
+ *
+ * handle() looks up (state, event) in O(1) whatever the table size, calls guard / action through
+ * member function pointers (no virtual call), then changes state
+ * post() queues an event from an ISR (ISR_callback, ISR_timeout...), dispatch() handles queued events from the loop
+ *
+ * 	enum State : uint8_t { JOIN, IDLE, SAMPLE, SEND, STATE_COUNT };
+ * 	enum Event : uint8_t { JOINED, TIMER, SENT, EVENT_COUNT };
+ *
+ * 	class Device {
+ * 		static constexpr FsmTransition<Device> transitions[] = {
+ * 			{ JOIN, JOINED, nullptr, &Device::startTimer, IDLE },
+ * 			{ IDLE, TIMER, &Device::batteryOk, &Device::sample, SAMPLE },
+ * 			...
+ * 		};
+ * 		static constexpr auto table = makeFsmTable<STATE_COUNT, EVENT_COUNT>(transitions);
+ * 		StateMachine<decltype(table)> _fsm { table, this, JOIN };
+ * 		void ISR_timeout() override { _fsm.post(TIMER); }
+ * 	};
+ *
+ * LOCK is the policy protecting the event queue against interrupts (see CriticalSection.h)
+ */
+template <typename TABLE, uint8_t QUEUE = 8, typename LOCK = PrimaskLock>
+class StateMachine {
+
+	using Target = typename TABLE::Target;
+
+	const TABLE &						_table;
+	Target *							_target;
+	volatile uint8_t					_state;
+	ArrayDeque<uint8_t, LOCK, QUEUE>	_events;
+
+public:
+
+	StateMachine(const TABLE & table, Target * target, uint8_t initial)
+		: _table(table), _target(target), _state(initial) {}
+
+	uint8_t state() const {
+		return _state;
+	}
+
+	/*
+	 * Forces current state (no action called)
+	 */
+	void reset(uint8_t state) {
+		_state = state;
+	}
+
+	/*
+	 * Handles event synchronously: action is called before the state change,
+	 * an action may post() further events but must not call handle()
+	 * returns false if no transition applies
+	 */
+	bool handle(uint8_t event) {
+		if (event >= TABLE::EVENT_COUNT)
+			return false;
+		uint8_t index = _table.lookup[_state][event];
+		while (index != TABLE::NONE) {
+			const FsmTransition<Target> & transition = _table.transitions[index];
+			if (transition.guard == nullptr || (_target->*transition.guard)()) {
+				if (transition.action != nullptr)
+					(_target->*transition.action)();
+				_state = transition.next;
+				return true;
+			}
+			index = _table.alternatives[index];
+		}
+		return false;
+	}
+
+	/*
+	 * Queues event (ISR-safe)
+	 * returns false if the queue is full
+	 */
+	bool post(uint8_t event) {
+		return _events.push_back(event);
+	}
+
+	/*
+	 * Handles at most max queued events
+	 * returns the number of events taken from the queue
+	 */
+	uint8_t dispatch(uint8_t max = QUEUE) {
+		uint8_t count = 0;
+		uint8_t event;
+		while (count < max && _events.pop_front(event)) {
+			handle(event);
+			count++;
+		}
+		return count;
+	}
+
+	uint8_t pending() const {
+		return _events.size();
+	}
+};
+
+}
+}
@@ -10,30 +10,37 @@
 
 #pragma once
 
+#include <FastGpio.h>
+#include <CriticalSection.h>
+
 #define LED_HIGH 	HIGH
 #define LED_LOW		LOW
 
 struct BlinkingLed {
 	const uint8_t _pin;
+	GpioPin _gpio;
 	unsigned long _interval;
 	unsigned long _previousTmst = 0;
 	int _state = LED_LOW;
 
 	BlinkingLed(uint8_t pin = LED_BUILTIN, uint32_t inter = 250)
-		: _pin(pin), _interval(inter*1000) {
+		: _pin(pin), _gpio(pin), _interval(inter*1000) {
 	}
 
 	void begin() {
-		pinMode(_pin, OUTPUT);
+		_gpio.output();
 	}
 
+	/*
+	 * Toggles the led each _interval, the port is written only on state change
+	 */
 	void blink() {
 		unsigned long currentTmst = micros();
 		if (currentTmst - _previousTmst >= _interval) {
 		    _previousTmst = currentTmst;
 		    _state = (_state == LED_LOW ? LED_HIGH : LED_LOW);
+		    _gpio.write(_state != LOW);
 		}
-		digitalWrite(_pin, _state);
 	}
 
 	operator bool() const {
@@ -59,7 +66,7 @@ struct BlinkingLed {
 	}
 
 	void updateState() {
-		digitalWrite(_pin, _state);
+		_gpio.write(_state != LOW);
 		_previousTmst = 0;
 	}
 
@@ -68,3 +75,268 @@ struct BlinkingLed {
 	}
 
 };
+
+/*
+ * Led pattern: sequence of steps stored in flash (const)
+ *
+ * each step sets a level (0 = off, 255 = full on, intermediate values need a PWM pin)
+ * during a number of engine ticks (1-127)
+ * LED_FADE in ticks makes the level move linearly from previous level during the step
+ */
+#define LED_FADE	0x80
+
+struct LedStep {
+	uint8_t level;
+	uint8_t ticks;
+};
+
+struct LedPattern {
+	const LedStep *	steps;
+	uint8_t			count;
+	uint8_t			repeat;		// 0 = forever
+};
+
+/*
+ * Predefined patterns for a 10 ms tick
+ */
+namespace LedPatterns {
+
+	constexpr LedStep HEARTBEAT_STEPS[] = { {255, 10}, {0, 10}, {255, 10}, {0, 70} };
+	constexpr LedStep BLINK_SLOW_STEPS[] = { {255, 50}, {0, 50} };
+	constexpr LedStep BLINK_FAST_STEPS[] = { {255, 10}, {0, 10} };
+	constexpr LedStep BREATHE_STEPS[] = { {255, 100 | LED_FADE}, {0, 100 | LED_FADE} };
+
+	constexpr LedPattern HEARTBEAT { HEARTBEAT_STEPS, 4, 0 };
+	constexpr LedPattern BLINK_SLOW { BLINK_SLOW_STEPS, 2, 0 };
+	constexpr LedPattern BLINK_FAST { BLINK_FAST_STEPS, 2, 0 };
+	constexpr LedPattern BREATHE { BREATHE_STEPS, 2, 0 };
+
+	/*
+	 * Error code: N short blinks then a pause
+	 * 	engine.play(led, LedPatterns::BlinkCode<3>::pattern);
+	 */
+	template <uint8_t N, uint8_t ON = 20, uint8_t OFF = 30, uint8_t PAUSE = 120>
+	struct BlinkCode {
+		struct Steps {
+			LedStep data[2*N];
+		};
+
+		static constexpr Steps make() {
+			Steps steps {};
+			for (uint8_t i = 0; i < N; i++) {
+				steps.data[2*i] = { 255, ON };
+				steps.data[2*i+1] = { 0, static_cast<uint8_t>(i == N-1 ? PAUSE : OFF) };
+			}
+			return steps;
+		}
+
+		static constexpr Steps steps = make();
+		static constexpr LedPattern pattern { steps.data, 2*N, 0 };
+	};
+}
+
+/*
+ * Plays patterns on several leds from a single periodic callback
+ *
+ * tick() is called every tickMs by a timer callback (ISR safe) or by the main loop
+ * play() / stop() may be called from the main loop, LOCK protects the shared state
+ *
+ * Low power mode: fades become steps, so that leds only change at step boundaries;
+ * nextChangeMs() gives the delay until the next change and advance() catches up
+ * after a standby period, instead of keeping the CPU awake to tick
+ */
+template <uint8_t SIZ = 4, typename LOCK = leuville::simple_template_library::PrimaskLock>
+class LedPatternEngine {
+
+	using Guard = leuville::simple_template_library::LockGuard<LOCK>;
+
+	struct Channel {
+		GpioPin				_gpio {0};
+		uint8_t				_pin = 0;
+		bool				_pwm = false;
+		const LedPattern *	_pattern = nullptr;
+		uint8_t				_step = 0;
+		uint8_t				_elapsed = 0;	// ticks elapsed in current step
+		uint8_t				_repeats = 0;
+		uint8_t				_from = 0;		// level at step start
+		uint8_t				_level = 0;		// current output level
+	};
+
+	Channel		_channels[SIZ];
+	uint8_t		_size = 0;
+	uint16_t	_tickMs;
+	uint16_t	_remainderMs = 0;	// part of a tick left by advance()
+	bool		_lowPower = false;
+
+	static uint8_t ticks(const LedStep & step) {
+		return step.ticks & ~LED_FADE;
+	}
+
+	static uint32_t period(const LedPattern & pattern) {
+		uint32_t res = 0;
+		for (uint8_t i = 0; i < pattern.count; i++) {
+			res += ticks(pattern.steps[i]);
+		}
+		return res;
+	}
+
+	bool fading(const LedStep & step) const {
+		return (step.ticks & LED_FADE) && ! _lowPower;
+	}
+
+	void output(Channel & c, uint8_t level) {
+		if (level == c._level)
+			return;
+		c._level = level;
+		if (c._pwm)
+			analogWrite(c._pin, level);
+		else
+			c._gpio.write(level != 0);
+	}
+
+	void startStep(Channel & c) {
+		c._elapsed = 0;
+		c._from = c._level;
+		const LedStep & step = c._pattern->steps[c._step];
+		if (! fading(step))
+			output(c, step.level);
+	}
+
+	void nextStep(Channel & c) {
+		if (++c._step == c._pattern->count) {
+			c._step = 0;
+			if (c._pattern->repeat != 0 && ++c._repeats >= c._pattern->repeat) {
+				c._pattern = nullptr;
+				output(c, 0);
+				return;
+			}
+		}
+		startStep(c);
+	}
+
+	/*
+	 * Advances a channel by count ticks, whole steps are skipped at once
+	 * and whole pattern periods are skipped without stepping (same step and position after a period)
+	 */
+	void advance(Channel & c, uint32_t count) {
+		if (c._pattern != nullptr) {
+			uint32_t len = period(*c._pattern);
+			if (len > 0 && count >= len) {
+				if (c._pattern->repeat == 0) {
+					count %= len;
+				} else {
+					// the last period is played, in order to stop the pattern
+					uint32_t cycles = count / len;
+					uint8_t left = c._pattern->repeat - c._repeats - 1;
+					if (cycles > left)
+						cycles = left;
+					c._repeats += cycles;
+					count -= cycles * len;
+				}
+			}
+		}
+		while (c._pattern != nullptr && count > 0) {
+			const LedStep & step = c._pattern->steps[c._step];
+			uint8_t left = ticks(step) - c._elapsed;
+			if (count < left) {
+				c._elapsed += count;
+				if (fading(step))
+					output(c, c._from + (int16_t)(step.level - c._from) * c._elapsed / ticks(step));
+				return;
+			}
+			count -= left;
+			if (fading(step))
+				output(c, step.level);
+			nextStep(c);
+		}
+	}
+
+public:
+
+	LedPatternEngine(uint16_t tickMs = 10): _tickMs(tickMs) {}
+
+	/*
+	 * Declares a led, pwm = true for fades (analogWrite)
+	 * returns the led index, used by play() and stop(), SIZ if no more room
+	 */
+	uint8_t attach(uint8_t pin, bool pwm = false) {
+		if (_size == SIZ)
+			return SIZ;
+		Channel & c = _channels[_size];
+		c._gpio = GpioPin(pin);
+		c._pin = pin;
+		c._pwm = pwm;
+		if (! pwm)
+			c._gpio.output();
+		c._gpio.low();
+		return _size++;
+	}
+
+	void play(uint8_t led, const LedPattern & pattern) {
+		Guard guard;
+		Channel & c = _channels[led];
+		c._pattern = &pattern;
+		c._step = 0;
+		c._repeats = 0;
+		startStep(c);
+	}
+
+	void stop(uint8_t led) {
+		Guard guard;
+		Channel & c = _channels[led];
+		c._pattern = nullptr;
+		output(c, 0);
+	}
+
+	bool playing(uint8_t led) const {
+		return _channels[led]._pattern != nullptr;
+	}
+
+	void setLowPower(bool lowPower) {
+		Guard guard;
+		_lowPower = lowPower;
+	}
+
+	/*
+	 * To be called every tickMs
+	 */
+	void tick() {
+		Guard guard;
+		for (uint8_t i = 0; i < _size; i++) {
+			advance(_channels[i], 1);
+		}
+	}
+
+	/*
+	 * Catches up after elapsedMs without tick (standby)
+	 * the part of a tick left is kept for the next call, so that the phase does not drift
+	 */
+	void advance(uint32_t elapsedMs) {
+		Guard guard;
+		uint64_t total = static_cast<uint64_t>(elapsedMs) + _remainderMs;
+		uint32_t count = total / _tickMs;
+		_remainderMs = total % _tickMs;
+		for (uint8_t i = 0; i < _size; i++) {
+			advance(_channels[i], count);
+		}
+	}
+
+	/*
+	 * Delay until the next led change, UINT32_MAX if no pattern is playing
+	 * the next wake-up (see ISRTimer) may be scheduled accordingly
+	 */
+	uint32_t nextChangeMs() const {
+		Guard guard;
+		uint32_t res = UINT32_MAX;
+		for (uint8_t i = 0; i < _size; i++) {
+			const Channel & c = _channels[i];
+			if (c._pattern == nullptr)
+				continue;
+			const LedStep & step = c._pattern->steps[c._step];
+			uint32_t delay = (fading(step) ? 1 : ticks(step) - c._elapsed) * _tickMs;
+			if (delay < res)
+				res = delay;
+		}
+		return res;
+	}
+};
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <Arduino.h>
+#include <CriticalSection.h>
+
+namespace leuville {
+namespace simple_template_library {
+
+/*
+ * Compressed buffer of timestamped integer samples (Gorilla-like, integer variant)
+ *
+ * RAM is split into BLOCKS blocks of BLOCK_SIZE bytes used as a ring, each block can be decoded alone:
+ * - first sample of a block: time and value kept in the block header
+ * - timestamps: delta of delta, '0' if the period is regular, else class prefix + 7 / 9 / 12 / 32 bits
+ * - values: zigzag delta, '0' if unchanged, else class prefix + 3 / 8 / 16 / 32 bits
+ * a regular period and slowly varying values cost a few bits per sample instead of 8 bytes
+ *
+ * When every block is used, append() evicts the oldest block
+ *
+ * LOCK is the policy protecting the object against interrupts (see CriticalSection.h)
+ */
+template <uint16_t BLOCK_SIZE = 128, uint8_t BLOCKS = 8, typename LOCK = NoLock>
+class TimeSeriesBuffer {
+
+	static_assert(BLOCKS >= 2, "at least 2 blocks are needed");
+	static_assert(BLOCK_SIZE >= 16 && BLOCK_SIZE <= 8191, "BLOCK_SIZE must be between 16 and 8191 bytes");
+
+	static constexpr uint16_t BLOCK_BITS = BLOCK_SIZE * 8;
+	static constexpr uint8_t MAX_SAMPLE_BITS = (4 + 32) * 2;
+	static constexpr uint8_t TIME_WIDTHS[4] = { 7, 9, 12, 32 };
+	static constexpr uint8_t VALUE_WIDTHS[4] = { 3, 8, 16, 32 };
+
+public:
+
+	struct Sample {
+		uint32_t	time;
+		int32_t		value;
+	};
+
+	struct Block {
+		uint32_t	seq;		// identifies the block contents
+		uint32_t	firstTime;
+		int32_t		firstValue;
+		uint16_t	count;
+		uint16_t	bits;
+	};
+
+protected:
+
+	using Guard = LockGuard<LOCK>;
+
+	uint8_t		_data[BLOCKS][BLOCK_SIZE];
+	Block		_blocks[BLOCKS];
+	uint8_t		_oldest = 0;
+	uint8_t		_current = 0;
+	uint8_t		_used = 0;		// blocks
+	uint32_t	_seq = 0;
+	uint32_t	_evicted = 0;	// samples
+	Sample		_last;
+	int32_t		_lastDelta = 0;
+
+	static uint32_t zigzag(int32_t value) {
+		return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	}
+
+	static int32_t unzigzag(uint32_t value) {
+		return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+	}
+
+	/*
+	 * a - b and a + b with wrap-around (unsigned arithmetic), any int32 step is encoded and decoded
+	 */
+	static int32_t wrapSub(uint32_t a, uint32_t b) {
+		return static_cast<int32_t>(a - b);
+	}
+
+	static int32_t wrapAdd(uint32_t a, uint32_t b) {
+		return static_cast<int32_t>(a + b);
+	}
+
+	static void writeBits(uint8_t * block, uint16_t & pos, uint32_t value, uint8_t bits) {
+		for (uint8_t i = 0; i < bits; i++, pos++) {
+			if ((value >> i) & 1)
+				block[pos >> 3] |= 1 << (pos & 7);
+		}
+	}
+
+	static uint32_t readBits(const uint8_t * block, uint16_t & pos, uint8_t bits) {
+		uint32_t value = 0;
+		for (uint8_t i = 0; i < bits; i++, pos++) {
+			value |= static_cast<uint32_t>((block[pos >> 3] >> (pos & 7)) & 1) << i;
+		}
+		return value;
+	}
+
+	/*
+	 * '0' for 0, else '10', '110', '1110' or '1111' followed by value on widths[class] bits
+	 */
+	static void writeClass(uint8_t * block, uint16_t & pos, uint32_t value, const uint8_t * widths) {
+		if (value == 0) {
+			writeBits(block, pos, 0, 1);
+			return;
+		}
+		uint8_t cls = 0;
+		while (cls < 3 && (value >> widths[cls]) != 0) cls++;
+		writeBits(block, pos, (1u << (cls + 1)) - 1, cls + 1);
+		if (cls < 3)
+			writeBits(block, pos, 0, 1);
+		writeBits(block, pos, value, widths[cls]);
+	}
+
+	static uint32_t readClass(const uint8_t * block, uint16_t & pos, const uint8_t * widths) {
+		uint8_t ones = 0;
+		while (ones < 4 && readBits(block, pos, 1) == 1) ones++;
+		if (ones == 0)
+			return 0;
+		return readBits(block, pos, widths[ones - 1]);
+	}
+
+	/*
+	 * following functions must be called inside a critical section
+	 */
+
+	void evictOldest() {
+		_evicted += _blocks[_oldest].count;
+		_blocks[_oldest].seq = 0;
+		_oldest = (_oldest + 1) % BLOCKS;
+		_used--;
+	}
+
+	void openBlock(const Sample & sample) {
+		if (_used > 0) {
+			_current = (_current + 1) % BLOCKS;
+		}
+		if (_used == BLOCKS) {
+			evictOldest();
+		}
+		memset(_data[_current], 0, BLOCK_SIZE);
+		_blocks[_current] = { ++_seq, sample.time, sample.value, 1, 0 };
+		_used++;
+		_lastDelta = 0;
+	}
+
+public:
+
+	/*
+	 * Sequential decoder, from the oldest sample
+	 * if blocks are evicted while reading, it continues from the new oldest block
+	 */
+	class Reader {
+		const TimeSeriesBuffer * _buffer;
+		uint32_t	_seq = 0;		// current block
+		uint16_t	_index = 0;		// next sample in block
+		uint16_t	_pos = 0;
+		Sample		_last;
+		int32_t		_lastDelta = 0;
+
+		bool seek(uint8_t block) {
+			const Block & info = _buffer->_blocks[block];
+			_seq = info.seq;
+			_index = 0;
+			_pos = 0;
+			return _seq != 0;
+		}
+
+		int16_t find(uint32_t seq) const {
+			for (uint8_t i = 0; i < BLOCKS; i++) {
+				if (_buffer->_blocks[i].seq == seq && seq != 0)
+					return i;
+			}
+			return -1;
+		}
+
+	public:
+
+		Reader(const TimeSeriesBuffer & buffer): _buffer(&buffer) {
+			rewind();
+		}
+
+		void rewind() {
+			Guard guard;
+			_seq = 0;
+			if (_buffer->_used > 0)
+				seek(_buffer->_oldest);
+		}
+
+		/*
+		 * returns false when every appended sample has been read
+		 */
+		bool next(Sample & sample) {
+			Guard guard;
+			if (_buffer->_used == 0)
+				return false;
+			int16_t block = find(_seq);
+			if (block < 0) {
+				// evicted or never started
+				block = _buffer->_oldest;
+				seek(block);
+			}
+			const Block * info = &_buffer->_blocks[block];
+			if (_index == info->count) {
+				if (block == _buffer->_current)
+					return false;
+				block = (block + 1) % BLOCKS;
+				seek(block);
+				info = &_buffer->_blocks[block];
+			}
+			if (_index == 0) {
+				_last = { info->firstTime, info->firstValue };
+				_lastDelta = 0;
+			} else {
+				const uint8_t * data = _buffer->_data[block];
+				_lastDelta = wrapAdd(_lastDelta, unzigzag(readClass(data, _pos, TIME_WIDTHS)));
+				_last.time += _lastDelta;
+				_last.value = wrapAdd(_last.value, unzigzag(readClass(data, _pos, VALUE_WIDTHS)));
+			}
+			_index++;
+			sample = _last;
+			return true;
+		}
+	};
+
+	TimeSeriesBuffer() {
+		for (uint8_t i = 0; i < BLOCKS; i++) {
+			_blocks[i].seq = 0;
+		}
+	}
+
+	/*
+	 * Appends a sample, time is increasing (seconds or milliseconds)
+	 * returns false if the oldest block has been evicted to make room
+	 */
+	bool append(uint32_t time, int32_t value) {
+		Guard guard;
+		Sample sample { time, value };
+		uint32_t evicted = _evicted;
+		Block & block = _blocks[_current];
+		if (_used == 0 || block.bits + MAX_SAMPLE_BITS > BLOCK_BITS || block.count == 0xFFFF) {
+			openBlock(sample);
+		} else {
+			int32_t delta = wrapSub(time, _last.time);
+			writeClass(_data[_current], block.bits, zigzag(wrapSub(delta, _lastDelta)), TIME_WIDTHS);
+			writeClass(_data[_current], block.bits, zigzag(wrapSub(value, _last.value)), VALUE_WIDTHS);
+			block.count++;
+			_lastDelta = delta;
+		}
+		_last = sample;
+		return evicted == _evicted;
+	}
+
+	/*
+	 * Removes the oldest block (e.g. once its samples have been sent)
+	 */
+	void dropOldest() {
+		Guard guard;
+		if (_used > 0) {
+			evictOldest();
+			if (_used == 0) _current = _oldest;
+		}
+	}
+
+	void clear() {
+		Guard guard;
+		while (_used > 0) evictOldest();
+		_current = _oldest;
+	}
+
+	/*
+	 * Number of stored samples
+	 */
+	uint32_t size() const {
+		Guard guard;
+		uint32_t res = 0;
+		for (uint8_t i = 0, block = _oldest; i < _used; i++, block = (block + 1) % BLOCKS) {
+			res += _blocks[block].count;
+		}
+		return res;
+	}
+
+	uint8_t usedBlocks() const {
+		return _used;
+	}
+
+	/*
+	 * Number of samples lost by eviction
+	 */
+	uint32_t evicted() const {
+		return _evicted;
+	}
+
+	/*
+	 * Oldest block: samples may be read with a Reader before dropOldest()
+	 */
+	uint16_t oldestCount() const {
+		Guard guard;
+		return (_used == 0 ? 0 : _blocks[_oldest].count);
+	}
+
+	constexpr uint32_t bytes() const {
+		return sizeof(_data);
+	}
+};
+
+}
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <Arduino.h>
+#include <type_traits>
+#include <ArrayDeque.h>
+
+namespace leuville {
+namespace simple_template_library {
+
+enum WindowMode : uint8_t { WINDOW_SLIDING, WINDOW_TUMBLING };
+
+/*
+ * Statistics (count, min, max, sum, mean, variance, standard deviation) over a window of samples
+ *
+ * WINDOW_SLIDING = last length samples, the oldest sample is evicted by each push once the window is full
+ * WINDOW_TUMBLING = consecutive windows of length samples, the push following a complete window starts a new one
+ * (samples are not stored)
+ *
+ * push() is O(1) amortized:
+ * - sum and sum of squares are accumulated on 64 bits integers (no soft-float on M0),
+ *   relative to a recent sample of the window (rebased every length samples in sliding mode)
+ * - min / max are the front of monotonic deques of (value, sequence number)
+ *
+ * T is an integral type, fixed-point values are scaled by the caller (e.g. centi-degrees)
+ * results are exact while the spread (max - min) of 2 consecutive windows is less than 2^32 / length:
+ * always true with 8 and 16 bits T, 214 millions with 32 bits T and length 20
+ * mean() and stddev() return fixed-point results with fracBits fractional bits
+ * (intermediate results are 64 bits: keep fracBits small for 32 bits samples)
+ *
+ * LOCK is the policy protecting the object against interrupts (see CriticalSection.h)
+ */
+template <typename T = int32_t, typename LOCK = NoLock, uint8_t SIZ = 20, uint8_t MODE = WINDOW_SLIDING>
+class WindowStats {
+
+	static_assert(std::is_integral<T>::value, "T must be an integral type");
+	static_assert(sizeof(T) <= 4, "T must be 32 bits at most");
+
+protected:
+
+	using Guard = LockGuard<LOCK>;
+
+	struct Sample {
+		T			value;
+		uint32_t	seq;
+	};
+
+	struct NoSamples {};
+
+	typename std::conditional<MODE == WINDOW_SLIDING, ArrayDeque<Sample, NoLock, SIZ>, NoSamples>::type _samples;
+	ArrayDeque<Sample, NoLock, SIZ>	_min;		// increasing values
+	ArrayDeque<Sample, NoLock, SIZ>	_max;		// decreasing values
+	int64_t		_offset = 0;		// sums are relative to this value
+	int64_t		_sum = 0;
+	uint64_t	_sumSquares = 0;
+	uint32_t	_seq = 0;
+	uint8_t		_count = 0;
+	uint8_t		_sinceRebase = 0;
+	uint8_t		_length;
+
+	/*
+	 * following functions must be called inside a critical section
+	 */
+
+	static uint64_t square(int64_t delta) {
+		uint64_t abs = static_cast<uint64_t>(delta < 0 ? -delta : delta);
+		return abs * abs;
+	}
+
+	void reset() {
+		if constexpr (MODE == WINDOW_SLIDING) {
+			while (! _samples.empty()) _samples.pop_back();
+		}
+		while (! _min.empty()) _min.pop_back();
+		while (! _max.empty()) _max.pop_back();
+		_sum = 0;
+		_sumSquares = 0;
+		_count = 0;
+		_sinceRebase = 0;
+	}
+
+	void evict() {
+		Sample oldest {};
+		_samples.pop_front(oldest);
+		_sum -= oldest.value - _offset;
+		_sumSquares -= square(oldest.value - _offset);
+		_count--;
+		if (_min.front().seq == oldest.seq) _min.pop_front();
+		if (_max.front().seq == oldest.seq) _max.pop_front();
+	}
+
+	/*
+	 * Sums relative to the oldest sample of the sliding window, O(length)
+	 */
+	void rebase() {
+		_sinceRebase = 0;
+		_offset = _samples.front().value;
+		_sum = 0;
+		_sumSquares = 0;
+		for (uint8_t i = 0; i < _count; i++) {
+			Sample sample {};
+			_samples.pop_front(sample);
+			_sum += sample.value - _offset;
+			_sumSquares += square(sample.value - _offset);
+			_samples.push_back(sample);
+		}
+	}
+
+	static uint64_t isqrt(uint64_t value) {
+		uint64_t res = 0;
+		uint64_t bit = 1ull << 62;
+		while (bit > value) bit >>= 2;
+		while (bit != 0) {
+			if (value >= res + bit) {
+				value -= res + bit;
+				res = (res >> 1) + bit;
+			} else {
+				res >>= 1;
+			}
+			bit >>= 2;
+		}
+		return res;
+	}
+
+	/*
+	 * n^2 * variance (n * sum of squares >= sum^2)
+	 */
+	uint64_t scaledVariance() const {
+		uint64_t squares = static_cast<uint64_t>(_count) * _sumSquares;
+		uint64_t sum2 = square(_sum);
+		return (squares > sum2 ? squares - sum2 : 0);
+	}
+
+public:
+
+	/*
+	 * length is the number of samples of a window (at most SIZ)
+	 */
+	WindowStats(uint8_t length = SIZ)
+		: _length(length > 0 && length <= SIZ ? length : SIZ) {}
+
+	/*
+	 * Adds a sample
+	 * returns true if the window is complete (sliding window full, or end of a tumbling window)
+	 */
+	bool push(T value) {
+		Guard guard;
+		if (_count == _length) {
+			if constexpr (MODE == WINDOW_TUMBLING)
+				reset();
+			else
+				evict();
+		}
+		if (_count == 0)
+			_offset = value;
+		Sample sample { value, _seq++ };
+		while (! _min.empty() && _min.back().value >= value) _min.pop_back();
+		_min.push_back(sample);
+		while (! _max.empty() && _max.back().value <= value) _max.pop_back();
+		_max.push_back(sample);
+		_sum += value - _offset;
+		_sumSquares += square(value - _offset);
+		_count++;
+		if constexpr (MODE == WINDOW_SLIDING) {
+			_samples.push_back(sample);
+			if (++_sinceRebase == _length)
+				rebase();
+		}
+		return _count == _length;
+	}
+
+	void clear() {
+		Guard guard;
+		reset();
+	}
+
+	uint8_t count() const {
+		return _count;
+	}
+
+	uint8_t length() const {
+		return _length;
+	}
+
+	bool complete() const {
+		return _count == _length;
+	}
+
+	/*
+	 * min(), max(): undefined if count() == 0
+	 */
+	T min() const {
+		Guard guard;
+		return _min.front().value;
+	}
+
+	T max() const {
+		Guard guard;
+		return _max.front().value;
+	}
+
+	int64_t sum() const {
+		Guard guard;
+		return _sum + _count * _offset;
+	}
+
+	/*
+	 * Rounded mean, scaled by 2^fracBits
+	 */
+	int32_t mean(uint8_t fracBits = 0) const {
+		Guard guard;
+		if (_count == 0)
+			return 0;
+		int64_t scaled = _sum * (1ll << fracBits);
+		int64_t half = _count / 2;
+		int64_t mean = (scaled >= 0 ? (scaled + half) / _count : (scaled - half) / _count);
+		return mean + _offset * (1ll << fracBits);
+	}
+
+	/*
+	 * Population variance, scaled by 2^(2 * fracBits)
+	 */
+	uint64_t variance(uint8_t fracBits = 0) const {
+		Guard guard;
+		if (_count == 0)
+			return 0;
+		uint64_t n2 = static_cast<uint64_t>(_count) * _count;
+		return ((scaledVariance() << (2 * fracBits)) + n2 / 2) / n2;
+	}
+
+	/*
+	 * Population standard deviation, scaled by 2^fracBits
+	 */
+	uint32_t stddev(uint8_t fracBits = 0) const {
+		Guard guard;
+		if (_count == 0)
+			return 0;
+		return (isqrt(scaledVariance() << (2 * fracBits)) + _count / 2) / _count;
+	}
+};
+
+}
+}
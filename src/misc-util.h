@@ -11,6 +11,8 @@
 #pragma once
 
 #include <Arduino.h>
+#include <CriticalSection.h>
+#include <Cobs.h>
 
 /*
  * Returns the capacity in terms of number of elements of a C array
@@ -156,6 +158,195 @@ inline String loraString(const char* hexString) {
 	return res;
 }
 
+/*
+ * Print sink which stores formatted bytes into a ring buffer
+ * instead of writing them directly to the serial port
+ *
+ * drain() sends buffered bytes in bulk as long as the port accepts them without blocking
+ * flush() blocks until the buffer is empty (before standby, fatal error)
+ * both copy CHUNK bytes at most under lock and write them outside of it: with DROP_OLDEST,
+ * bytes evicted by an ISR write() meanwhile are still sent once (and counted as dropped)
+ *
+ * May be used as STYPE of USBPrinter:
+ *
+ *   BufferedPrint<Serial_> logBuffer(Serial);
+ *   USBPrinter<BufferedPrint<Serial_>> logger(logBuffer);
+ *
+ * LOCK is the policy protecting the buffer against interrupts (see CriticalSection.h)
+ */
+template <typename STYPE, typename LOCK = leuville::simple_template_library::NoLock, uint16_t SIZ = 256>
+class BufferedPrint: public Print {
+protected:
+
+	using Guard = leuville::simple_template_library::LockGuard<LOCK>;
+
+	STYPE &		_serial;
+	uint8_t 	_data[SIZ];
+	uint16_t	_head = 0;		// oldest buffered byte
+	uint16_t	_size = 0;
+	uint32_t	_dropped = 0;
+	uint32_t	_consumed = 0;		// bytes removed from the buffer since startup (sent or evicted)
+	uint8_t		_fullPolicy = DROP_NEWEST;
+
+	static constexpr uint16_t CHUNK = 64;	// USB CDC packet
+
+	/*
+	 * Number of bytes which may be read from _head without wrapping
+	 */
+	uint16_t contiguous() const {
+		uint16_t toEnd = SIZ - _head;
+		return (_size < toEnd ? _size : toEnd);
+	}
+
+	void consume(uint16_t count) {
+		_head = (_head + count) % SIZ;
+		_size -= count;
+		_consumed += count;
+	}
+
+	/*
+	 * Copies at most len bytes from the head of the buffer
+	 * start receives the position of the first byte, see release()
+	 */
+	uint16_t peek(uint8_t* dst, uint16_t len, uint32_t & start) {
+		Guard guard;
+		uint16_t count = (_size < len ? _size : len);
+		uint16_t first = contiguous();
+		if (first > count)
+			first = count;
+		memcpy(dst, &_data[_head], first);
+		memcpy(dst + first, &_data[0], count - first);
+		start = _consumed;
+		return count;
+	}
+
+	/*
+	 * Removes sent bytes from the buffer, except those evicted by DROP_OLDEST since peek()
+	 */
+	void release(uint32_t start, size_t sent) {
+		Guard guard;
+		uint32_t evicted = _consumed - start;
+		if (sent > evicted)
+			consume(sent - evicted);
+	}
+
+public:
+
+	/*
+	 * fullPolicy is policy to apply when buffer is full
+	 * DROP_NEWEST = incoming write is discarded as a whole (a message is never truncated)
+	 * DROP_OLDEST = oldest buffered bytes are overwritten
+	 * both policies count discarded bytes (see dropped())
+	 */
+	enum { DROP_NEWEST, DROP_OLDEST };
+
+	BufferedPrint(STYPE & serial, uint8_t fullPolicy = DROP_NEWEST)
+		: _serial(serial), _fullPolicy(fullPolicy) {
+	}
+
+	void begin(uint32_t baud) {
+		_serial.begin(baud);
+	}
+
+	int available() {
+		return _serial.available();
+	}
+
+	virtual size_t write(uint8_t c) override {
+		return write(&c, 1);
+	}
+
+	virtual size_t write(const uint8_t *buffer, size_t count) override {
+		Guard guard;
+		size_t room = SIZ - _size;
+		if (count > room) {
+			if (_fullPolicy == DROP_NEWEST) {
+				_dropped += count;
+				return 0;
+			} else {
+				if (count > SIZ) {
+					_dropped += count - SIZ;
+					buffer += count - SIZ;
+					count = SIZ;
+				}
+				_dropped += count - room;
+				consume(count - room);
+			}
+		}
+		uint16_t tail = (_head + _size) % SIZ;
+		size_t first = (count < (size_t)(SIZ - tail) ? count : SIZ - tail);
+		memcpy(&_data[tail], buffer, first);
+		memcpy(&_data[0], buffer + first, count - first);
+		_size += count;
+		return count;
+	}
+
+	/*
+	 * Sends buffered bytes while the serial port accepts them without blocking
+	 * To be called from the main loop
+	 *
+	 * returns the number of bytes sent
+	 */
+	size_t drain() {
+		size_t sent = 0;
+		int room = _serial.availableForWrite();
+		uint8_t chunk[CHUNK];
+		while (room > 0) {
+			uint32_t start;
+			uint16_t len = peek(chunk, (room < CHUNK ? room : CHUNK), start);
+			if (len == 0)
+				break;
+			size_t n = _serial.write(chunk, len);
+			if (n == 0)
+				break;
+			release(start, n);
+			sent += n;
+			room -= n;
+		}
+		return sent;
+	}
+
+	/*
+	 * Sends all buffered bytes, blocking until the serial port has written them
+	 * To be called before standby or on fatal error
+	 * gives up if the port does not accept bytes anymore (USB disconnected)
+	 */
+	virtual void flush() override {
+		uint8_t chunk[CHUNK];
+		for (;;) {
+			uint32_t start;
+			uint16_t len = peek(chunk, CHUNK, start);
+			if (len == 0)
+				break;
+			size_t n = _serial.write(chunk, len);
+			if (n == 0)
+				break;
+			release(start, n);
+		}
+		_serial.flush();
+	}
+
+	uint16_t size() const {
+		return _size;
+	}
+
+	constexpr uint16_t max_size() const {
+		return SIZ;
+	}
+
+	/*
+	 * Number of bytes discarded since last call to resetDropped()
+	 */
+	uint32_t dropped() const {
+		return _dropped;
+	}
+
+	void resetDropped() {
+		Guard guard;
+		_dropped = 0;
+	}
+};
+
 /*
  * USB print
  */
@@ -173,6 +364,13 @@ struct USBPrinter {
 		return _serial.available();
 	}
 
+	/*
+	 * Waits for pending bytes to be sent (buffered bytes with BufferedPrint)
+	 */
+	void flush() {
+		_serial.flush();
+	}
+
 	template <typename T>
 	void print(const T data) {
 		_serial.print(data);
@@ -230,6 +428,25 @@ struct USBPrinter {
 		_serial.println("");
 	}
 
+	/*
+	 * Sends binary data as one COBS frame delimited by 0x00 (see Cobs.h and extras/cobs)
+	 * about half the bytes of printHex(); cobsEncode() issues one write() per block code byte
+	 * and per span slice, hence the gain in calls over raw USB serial needs a BufferedPrint STYPE
+	 * with a BufferedPrint, bytes dropped when the buffer is full may leave a shorter frame:
+	 * add a CRC to the data (see Crc.h) if frames must be checked
+	 */
+	size_t writeFrame(const uint8_t* data, size_t len) {
+		return cobsEncode(_serial, data, len);
+	}
+
+	/*
+	 * Frame made of two parts, without copy (e.g. wrapped contents of a ring buffer)
+	 */
+	size_t writeFrame(const uint8_t* first, size_t firstLen, const uint8_t* second, size_t secondLen) {
+		CobsSpan spans[2] = { { first, firstLen }, { second, secondLen } };
+		return cobsEncode(_serial, spans, 2);
+	}
+
 };
 
 /*